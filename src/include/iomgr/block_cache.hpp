@@ -0,0 +1,139 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include <folly/futures/Future.h>
+#include <sisl/metrics/metrics.hpp>
+#include <iomgr/drive_interface.hpp>
+
+namespace iomgr {
+ENUM(cache_write_policy, uint8_t, write_through, write_around)
+
+struct block_cache_params {
+    uint64_t capacity{64ul * 1024ul * 1024ul}; // Bytes of data cached across all shards
+    uint32_t block_size{4096};
+    uint32_t num_shards{0}; // 0 means one shard per worker reactor
+    cache_write_policy write_policy{cache_write_policy::write_through};
+};
+
+class BlockCacheMetrics : public sisl::MetricsGroup {
+public:
+    explicit BlockCacheMetrics(const std::string& name) : sisl::MetricsGroup("BlockCache", name) {
+        REGISTER_COUNTER(cache_hits, "Number of blocks read from the cache");
+        REGISTER_COUNTER(cache_misses, "Number of blocks read from the device on cache miss");
+        REGISTER_COUNTER(cache_evictions, "Number of blocks evicted to make room for others");
+        REGISTER_COUNTER(cache_invalidations, "Number of blocks dropped on write, unmap or write zero");
+        REGISTER_COUNTER(cache_bypass_ios, "Number of ios not aligned to the cache block, issued bypassing cache");
+        REGISTER_GAUGE(cache_hit_ratio_pct, "Percentage of blocks read from the cache");
+        REGISTER_GAUGE(cache_used_bytes, "Bytes of data cached");
+        register_me_to_farm();
+    }
+
+    ~BlockCacheMetrics() {
+        detach_gather_cb();
+        deregister_me_from_farm();
+    }
+};
+
+// Cache of device blocks in iobuf memory, in front of the drive interface of the devices. Reads are served from the
+// cache and the missed blocks are read from the device and then cached. Writes either update the cached blocks once
+// they complete (write_through) or just drop them (write_around). Unmap and write zero drop the cached blocks of their
+// range. Cache is split into shards by block, each with its own lock and CLOCK eviction. A block is marked referenced
+// on a hit, so blocks read only once are the first to be evicted.
+//
+// Ios of size and offset not aligned to the block size bypass the cache, writes of those drop the blocks they touch.
+// Devices written bypassing this cache have to be invalidated by the caller.
+class BlockCache {
+public:
+    BlockCache(const std::string& name, const block_cache_params& params);
+    ~BlockCache();
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    folly::Future< std::error_code > async_read(IODevice* iodev, char* data, uint32_t size, uint64_t offset);
+    folly::Future< std::error_code > async_write(IODevice* iodev, const char* data, uint32_t size, uint64_t offset);
+    folly::Future< std::error_code > async_unmap(IODevice* iodev, uint32_t size, uint64_t offset);
+    folly::Future< std::error_code > async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset);
+
+    void invalidate(IODevice* iodev, uint64_t offset, uint64_t size);
+    void invalidate_device(IODevice* iodev);
+
+    double hit_ratio() const;
+    uint64_t used_bytes() const { return m_used_blocks.load(std::memory_order_relaxed) * m_block_size; }
+    const block_cache_params& params() const { return m_params; }
+
+private:
+    struct block_key {
+        IODevice* iodev;
+        uint64_t blkno;
+        bool operator==(const block_key& other) const { return (iodev == other.iodev) && (blkno == other.blkno); }
+    };
+    struct block_key_hash {
+        size_t operator()(const block_key& k) const;
+    };
+
+    struct slot {
+        block_key key{nullptr, 0};
+        uint8_t* buf{nullptr};
+        bool valid{false};
+        bool referenced{false};
+    };
+
+    struct shard {
+        std::mutex mtx;
+        std::unordered_map< block_key, uint32_t, block_key_hash > index;
+        std::vector< slot > slots;
+        uint32_t hand{0};
+        // Bumped on every write and invalidation of its blocks, so that reads which started before don't cache the
+        // data they read
+        uint64_t seq{0};
+    };
+
+    bool is_aligned(uint64_t offset, uint64_t size) const {
+        return ((offset % m_block_size) == 0) && ((size % m_block_size) == 0) && (size != 0);
+    }
+    shard& shard_of(const block_key& key);
+    uint64_t total_slots() const { return m_shards.size() * m_shards[0]->slots.size(); }
+    // Copies the block to dst if cached, returns the seq of its shard either way
+    bool lookup(const block_key& key, uint8_t* dst, uint64_t& seq);
+    void insert(shard& s, const block_key& key, const uint8_t* src);
+    uint32_t evict_one(shard& s);
+    void drop(shard& s, uint32_t idx);
+    // Caches the blocks read from device, unless their shard has seen a write or invalidation since the read started
+    void fill(IODevice* iodev, uint64_t first_blkno, uint64_t nblks, const uint8_t* data, const uint64_t* seqs);
+    void update(IODevice* iodev, uint64_t first_blkno, uint64_t nblks, const uint8_t* data);
+    void invalidate_if(const std::function< bool(const block_key&) >& pred);
+    folly::Future< std::error_code > invalidate_on_completion(folly::Future< std::error_code >&& f, IODevice* iodev,
+                                                              uint64_t offset, uint64_t size);
+    void on_gather();
+
+private:
+    const block_cache_params m_params;
+    const uint32_t m_block_size;
+    std::vector< std::unique_ptr< shard > > m_shards;
+    std::atomic< uint64_t > m_hits{0};
+    std::atomic< uint64_t > m_misses{0};
+    std::atomic< uint64_t > m_used_blocks{0};
+    BlockCacheMetrics m_metrics;
+};
+} // namespace iomgr
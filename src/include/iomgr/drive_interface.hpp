@@ -18,9 +18,11 @@
 #include <fcntl.h>
 #include <cstdint>
 #include <filesystem>
+#include <array>
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <span>
 #include <system_error>
 
 #include <nlohmann/json.hpp>
@@ -33,6 +35,20 @@ namespace iomgr {
 ENUM(drive_interface_type, uint8_t, aio, spdk, uring)
 ENUM(DriveOpType, uint8_t, WRITE, READ, UNMAP, WRITE_ZERO, FSYNC)
 
+// Priority class of an io, used by the QoS of its device. Ios take the class of the submitting thread, see
+// DriveInterface::set_thread_io_class
+ENUM(io_class, uint8_t, latency_critical, normal, background)
+static constexpr uint32_t num_io_classes{3};
+
+// QoS of a device, limits of 0 mean unlimited. When ios of classes contend for the device, they are admitted in the
+// ratio of class weights and each class can have at most max_depth ios outstanding on the device.
+struct drive_qos_params {
+    uint64_t iops_limit{0};
+    uint64_t bw_limit{0}; // Bytes per second of reads and writes
+    std::array< uint32_t, num_io_classes > weights{16, 4, 1};
+    std::array< uint32_t, num_io_classes > max_depth{0, 0, 0};
+};
+
 struct drive_attributes {
     uint32_t phys_page_size{4096};        // Physical page size of flash ssd/nvme. This is optimal size to do IO
     uint32_t align_size{0};               // size alignment supported by drives/kernel
@@ -66,6 +82,8 @@ public:
         REGISTER_COUNTER(read_io_submission_errors, "read submission errors", "io_submission_errors",
                          {"io_direction", "read"});
         REGISTER_COUNTER(resubmit_io_on_err, "number of times ios are resubmitted");
+        REGISTER_COUNTER(merged_ios, "Number of ios issued for the contiguous batched ios merged together");
+        REGISTER_COUNTER(merged_member_ios, "Number of batched ios which were merged into another io");
 
         REGISTER_COUNTER(outstanding_write_cnt, "outstanding write cnt", sisl::_publish_as::publish_as_gauge);
         REGISTER_COUNTER(outstanding_read_cnt, "outstanding read cnt", sisl::_publish_as::publish_as_gauge);
@@ -77,6 +95,29 @@ public:
     virtual ~DriveInterfaceMetrics() { deregister_me_from_farm(); }
 };
 
+// Completion of callback flavor of async APIs, fn is called with the cookie on the reactor where IO completes. Unlike
+// the future based APIs, it doesn't need any allocation to deliver the completion.
+using drive_comp_fn_t = void (*)(std::error_code err, void* cookie);
+struct drive_comp_cb {
+    drive_comp_fn_t fn{nullptr};
+    void* cookie{nullptr};
+};
+
+// One IO of a vectored submission. Either data or iov/iovcnt describes the buffer of READ/WRITE, other ops ignore
+// them. FSYNC ignores size and offset as well. Requests of a single submission can be of any op and device.
+struct drive_io_request {
+    IODevice* iodev{nullptr};
+    DriveOpType op_type{DriveOpType::WRITE};
+    char* data{nullptr};
+    const iovec* iov{nullptr};
+    int iovcnt{0};
+    uint64_t size{0};
+    uint64_t offset{0};
+    drive_comp_cb cb;
+
+    bool is_valid() const;
+};
+
 class DriveInterface;
 struct drive_iocb {
 #ifndef NDEBUG
@@ -84,7 +125,10 @@ struct drive_iocb {
 #endif
     static constexpr int inlined_iov_count = 4;
     typedef std::array< iovec, inlined_iov_count > inline_iov_array;
-    typedef std::unique_ptr< iovec[] > large_iov_array;
+    struct large_iov_deleter {
+        void operator()(iovec* iovs) const;
+    };
+    typedef std::unique_ptr< iovec[], large_iov_deleter > large_iov_array;
 
     IODevice* iodev;
     DriveInterface* iface;
@@ -95,10 +139,14 @@ struct drive_iocb {
     int iovcnt = 0;
     int64_t result{-1};
     std::variant< io_interface_comp_cb_t, folly::Promise< std::error_code >,
-                  FiberManagerLib::Promise< std::error_code > >
+                  FiberManagerLib::Promise< std::error_code >, drive_comp_cb >
         completion{nullptr};
     uint32_t resubmit_cnt{0};
     uint32_t part_read_resubmit_cnt{0}; // only valid for uring interface
+    bool durable{false};                 // Write completes only after data is flushed to stable media
+    bool qos_admitted{false};            // Counted by the QoS of the device until it completes
+    io_class ioclass{io_class::normal};
+    drive_iocb* merged_next{nullptr}; // Next io merged along with this one into a single io of the batch
     IOReactor* initiating_reactor;
 #ifndef NDEBUG
     uint64_t iocb_id;
@@ -131,6 +179,9 @@ public:
         return std::get< FiberManagerLib::Promise< std::error_code > >(completion);
     }
 
+    // Delivers the completion to whichever completion is set on this iocb
+    void complete(const std::error_code& err);
+
     std::string to_string() const;
 };
 
@@ -154,8 +205,31 @@ public:
                                                          bool part_of_batch = false) = 0;
     virtual folly::Future< std::error_code > async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) = 0;
     virtual folly::Future< std::error_code > queue_fsync(IODevice* iodev) = 0;
+
+    // Write which completes only after the data is flushed to stable media. Default implementation issues a flush
+    // after the write completes, interfaces override it to avoid the additional round trip.
+    virtual folly::Future< std::error_code > async_write_durable(IODevice* iodev, const char* data, uint32_t size,
+                                                                 uint64_t offset);
+    virtual folly::Future< std::error_code > async_writev_durable(IODevice* iodev, const iovec* iov, int iovcnt,
+                                                                  uint32_t size, uint64_t offset);
+
+    // Callback flavor of async APIs, cb is invoked on the reactor once the IO completes. Default implementation
+    // builds on the future based APIs, interfaces override them to avoid the future allocation.
+    virtual void async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset,
+                                const drive_comp_cb& cb, bool part_of_batch = false);
+    virtual void async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                 const drive_comp_cb& cb, bool part_of_batch = false);
+    virtual void async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                               bool part_of_batch = false);
+    virtual void async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                const drive_comp_cb& cb, bool part_of_batch = false);
     virtual void submit_batch() = 0;
 
+    // Submits all the requests in one shot, completion of each request is delivered to its cb. Invalid requests are
+    // completed with EINVAL. Default implementation issues them one by one, interfaces override it to prepare all of
+    // them and submit to the device in a single call.
+    virtual void async_submit(std::span< const drive_io_request > reqs);
+
     virtual std::error_code sync_write(IODevice* iodev, const char* data, uint32_t size, uint64_t offset) = 0;
     virtual std::error_code sync_writev(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
                                         uint64_t offset) = 0;
@@ -181,7 +255,26 @@ public:
     static bool inject_delay_if_needed(drive_iocb* iocb, std::function< void(drive_iocb*) > delayed_cb);
 #endif
 
+    // Sets or updates the QoS of the device. It applies to the async ios of every interface, sync ios of kernel
+    // interfaces bypass it. First call on a device has to be made before issuing ios on it, later calls can update
+    // the params anytime.
+    static void set_qos(IODevice* iodev, const drive_qos_params& params);
+    // Ios submitted by this thread from now on are of this class
+    static void set_thread_io_class(io_class cls);
+    static io_class thread_io_class();
+    // Returns false if the io is held back by the QoS of its device, it is submitted later once admitted
+    static bool qos_admit(drive_iocb* iocb);
+
 protected:
+    friend class DriveQoS;
+    // Submits the io which was held back by the QoS of its device, on whichever thread it got admitted
+    virtual void submit_qos_admitted(drive_iocb* iocb) = 0;
+    // Stops the QoS of the device being closed, so that no io is left held back and its timer is gone
+    static void stop_qos(IODevice* iodev);
+
+    // Issues one request of a vectored submission through the regular async APIs
+    void submit_request(const drive_io_request& req, bool part_of_batch);
+
     virtual size_t get_dev_size(IODevice* iodev) = 0;
     virtual drive_attributes get_attributes(const std::string& devname, const drive_type drive_type) = 0;
     virtual io_device_ptr open_dev(const std::string& dev_name, drive_type dev_type, int oflags) = 0;
@@ -13,6 +13,7 @@ struct spdk_bdev;
 namespace iomgr {
 class IOInterface;
 class DriveInterface;
+class DriveQoS;
 
 inline backing_dev_t null_backing_dev() { return backing_dev_t{std::in_place_type< spdk_bdev_desc* >, nullptr}; }
 
@@ -41,6 +42,11 @@ public:
     sisl::atomic_counter< int32_t > thread_op_pending_count{0}; // Number of add/remove of iodev to thread pending
     drive_type dtype{drive_type::unknown};
     std::function< void(IODevice*) > post_add_remove_cb{nullptr};
+    int32_t fixed_file_idx{-1}; // Slot in the uring fixed file table, -1 if not registered
+    bool polled_io{false};      // IOs on this device are completed by polling the device instead of interrupts
+
+    // Set once QoS is configured on the device and lives as long as the device
+    std::shared_ptr< DriveQoS > qos;
 
 #ifdef REFCOUNTED_OPEN_DEV
     sisl::atomic_counter< int > opened_count{0};
@@ -2,10 +2,28 @@
 #include <sisl/utility/thread_factory.hpp>
 #include "epoll/iomgr_impl_epoll.hpp"
 #include "epoll_mem.hpp"
+#include "interfaces/uring_mempool.hpp"
+#include "iomgr_config.hpp"
 
 namespace iomgr {
 void IOManagerEpollImpl::pre_interface_init() {
-    sisl::AlignedAllocator::instance().set_allocator(std::move(new IOMgrAlignedAllocImpl()));
+    // Uring drive interface registers this pool as fixed buffers on its rings, so iobuf pool allocations are routed
+    // to it, to let IOs on them use fixed buffers
+    const uint64_t fixed_buf_size = IM_DYNAMIC_CONFIG(uring.fixed_buf_size_mb) * 1024ul * 1024ul;
+    if (iomanager.is_uring_capable() && (fixed_buf_size != 0)) {
+        auto pool = std::make_shared< UringMemPool >();
+        for (const auto& pool_entry : IM_DYNAMIC_CONFIG(iomem->pool_sizes)) {
+            uint64_t count = (fixed_buf_size / pool_entry->size) * (pool_entry->percent) / 100;
+            if (count && pool_entry->size) { pool->create(pool_entry->size, count); }
+        }
+        if (!pool->empty()) { m_uring_mempool = std::move(pool); }
+    }
+
+    if (m_uring_mempool) {
+        sisl::AlignedAllocator::instance().set_allocator(std::move(new UringAlignedAllocImpl(m_uring_mempool)));
+    } else {
+        sisl::AlignedAllocator::instance().set_allocator(std::move(new IOMgrAlignedAllocImpl()));
+    }
 }
 
 void IOManagerEpollImpl::post_interface_init() {}
@@ -22,5 +40,8 @@ sys_thread_id_t IOManagerEpollImpl::create_reactor_impl(const std::string& name,
 
 void IOManagerEpollImpl::pre_interface_stop() {}
 
-void IOManagerEpollImpl::post_interface_stop() {}
+void IOManagerEpollImpl::post_interface_stop() {
+    // Allocator holds on to the pool, so that iobufs still outstanding after stop can be freed back to it
+    m_uring_mempool.reset();
+}
 } // namespace iomgr
\ No newline at end of file
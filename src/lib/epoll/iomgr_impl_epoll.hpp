@@ -4,6 +4,8 @@
 #include "iomgr_impl.hpp"
 
 namespace iomgr {
+class UringMemPool;
+
 class IOManagerEpollImpl : public IOManagerImpl {
 public:
     IOManagerEpollImpl() = default;
@@ -14,6 +16,9 @@ public:
                                         int slot_num, thread_state_notifier_t&& notifier) override;
     void pre_interface_stop() override;
     void post_interface_stop() override;
+
+private:
+    shared< UringMemPool > m_uring_mempool; // Registered as fixed buffers of uring, null if not configured
 };
 
 } // namespace iomgr
@@ -55,6 +55,8 @@
 
 #include <iomgr/iomgr.hpp>
 #include "interfaces/aio_drive_interface.hpp"
+#include "interfaces/drive_io_merge.hpp"
+#include "interfaces/iocb_slab.hpp"
 #include "iomgr_config.hpp"
 #include "reactor/reactor.hpp"
 
@@ -77,9 +79,14 @@ using namespace std;
 thread_local std::unique_ptr< aio_thread_context > AioDriveInterface::t_aio_ctx;
 std::vector< int > AioDriveInterface::s_poll_interval_table;
 
+static drive_aio_iocb* alloc_iocb(DriveInterface* iface, IODevice* iodev, DriveOpType op_type, uint64_t size,
+                                  uint64_t offset) {
+    return slab_new< drive_aio_iocb >(IM_DYNAMIC_CONFIG(drive.iocb_cache_count), iface, iodev, op_type, size, offset);
+}
+
 static drive_aio_iocb* prep_iocb(DriveInterface* iface, IODevice* iodev, DriveOpType op_type, char* data, uint64_t size,
                                  uint64_t offset) {
-    auto diocb = new drive_aio_iocb(iface, iodev, op_type, size, offset);
+    auto diocb = alloc_iocb(iface, iodev, op_type, size, offset);
     diocb->set_data(data);
     auto* kernel_iocb = &diocb->kernel_iocb;
 
@@ -101,7 +108,7 @@ static drive_aio_iocb* prep_iocb(DriveInterface* iface, IODevice* iodev, DriveOp
 
 static drive_aio_iocb* prep_iocb_v(DriveInterface* iface, IODevice* iodev, DriveOpType op_type, const iovec* iov,
                                    int iovcnt, uint32_t size, uint64_t offset) {
-    auto diocb = new drive_aio_iocb(iface, iodev, op_type, size, offset);
+    auto diocb = alloc_iocb(iface, iodev, op_type, size, offset);
     diocb->set_iovs(iov, iovcnt);
     auto* kernel_iocb = &diocb->kernel_iocb;
 
@@ -147,6 +154,7 @@ io_device_ptr AioDriveInterface::open_dev(const std::string& devname, drive_type
 }
 
 void AioDriveInterface::close_dev(const io_device_ptr& iodev) {
+    DriveInterface::stop_qos(iodev.get());
     // TODO: This is where we would wait for any outstanding io's to complete
 
     IOInterface::close_dev(iodev);
@@ -163,9 +171,12 @@ void AioDriveInterface::init_iface_reactor_context(IOReactor*) {
                                                       bind_this(AioDriveInterface::on_event_notification, 3));
     t_aio_ctx->m_poll_cb_idx =
         iomanager.this_reactor()->register_poll_interval_cb(bind_this(AioDriveInterface::handle_completions, 0));
+    t_aio_ctx->m_loop_end_cb_idx =
+        iomanager.this_reactor()->register_loop_end_cb(bind_this(AioDriveInterface::submit_batch, 0));
 }
 
 void AioDriveInterface::clear_iface_reactor_context(IOReactor*) {
+    iomanager.this_reactor()->unregister_loop_end_cb(t_aio_ctx->m_loop_end_cb_idx);
     iomanager.this_reactor()->unregister_poll_interval_cb(t_aio_ctx->m_poll_cb_idx);
     iomanager.generic_interface()->remove_io_device(t_aio_ctx->m_ev_io_dev);
     t_aio_ctx.reset(nullptr);
@@ -185,8 +196,7 @@ void AioDriveInterface::on_event_notification(IODevice* iodev, [[maybe_unused]]
 void AioDriveInterface::handle_completions() {
     auto& tmetrics = iomanager.this_thread_metrics();
 
-    const int nevents =
-        io_getevents(t_aio_ctx->m_ioctx, 0, t_aio_ctx->m_events.size(), t_aio_ctx->m_events.data(), NULL);
+    const int nevents = t_aio_ctx->reap_events();
     ++tmetrics.io_callbacks;
 
     if (nevents == 0) {
@@ -197,6 +207,8 @@ void AioDriveInterface::handle_completions() {
         COUNTER_INCREMENT(m_metrics, completion_errors, 1);
     } else {
         tmetrics.aio_events_in_callback += nevents;
+        COUNTER_INCREMENT_IF_ELSE(m_metrics, t_aio_ctx->m_user_reap, user_reaped_events, syscall_reaped_events,
+                                  nevents);
     }
 
     for (int i = 0; i < nevents; ++i) {
@@ -210,14 +222,22 @@ void AioDriveInterface::handle_completions() {
 
         LOGTRACEMOD(iomgr, "Event[{}]: Result {} res2={}", i, e.res, e.res2);
         if (ret < 0) {
+            // Kernel reports the errors of fsync and of the IOs failed by the device as negated errno
             COUNTER_INCREMENT(m_metrics, completion_errors, 1);
-            LOGDFATAL("Error in completion of aio, result: {} diocb: {}", ret, diocb->to_string());
-        } else if ((e.res != diocb->size) || e.res2) {
+            LOGERROR("Error in completion of aio, result: {} diocb: {}", ret, diocb->to_string());
+            if (handle_io_failure(diocb, -ret, false /* at_submit */)) { continue; }
+        } else if ((e.res != expected_result(diocb)) || e.res2) {
             COUNTER_INCREMENT(m_metrics, completion_errors, 1);
             LOGERROR("io is not completed properly. size read/written {} diocb {} error {}", e.res, diocb->to_string(),
                      e.res2);
             if (e.res2 == 0) { e.res2 = EIO; }
-            if (handle_io_failure(diocb, e.res2)) { continue; }
+            if (handle_io_failure(diocb, e.res2, false /* at_submit */)) { continue; }
+        } else if ((diocb->op_type == DriveOpType::WRITE_ZERO) && (diocb->size > e.res)) {
+            // Move on to the next chunk of the range
+            diocb->offset += e.res;
+            diocb->size -= e.res;
+            prep_write_zero_chunk(diocb);
+            submit_in_this_thread(this, diocb, false /* part_of_batch */);
         } else {
             diocb->result = 0;
             complete_io(diocb);
@@ -239,7 +259,7 @@ bool AioDriveInterface::submit_io(drive_aio_iocb* diocb) {
     auto kiocb = &diocb->kernel_iocb;
     auto ret = io_submit(t_aio_ctx->m_ioctx, 1, &kiocb);
     if (ret != 1) {
-        handle_io_failure(diocb, errno);
+        handle_io_failure(diocb, (ret < 0) ? -ret : EAGAIN, true /* at_submit */);
         return false;
     }
 
@@ -248,19 +268,93 @@ bool AioDriveInterface::submit_io(drive_aio_iocb* diocb) {
 }
 
 void AioDriveInterface::submit_batch() {
-    auto n_issued = io_submit(t_aio_ctx->m_ioctx, t_aio_ctx->m_cur_batch_size, t_aio_ctx->m_iocb_batch.data());
-    if (n_issued < 0) { n_issued = 0; }
+    // Batch accumulated outside the reactors is submitted by the reactor, at the end of its loop
+    if ((t_aio_ctx == nullptr) || t_aio_ctx->m_iocb_batch.empty()) { return; }
+
+    // Batch is taken out of the context, since completion of a failed io could add to the batch again from within
+    std::vector< kernel_iocb_t* > batch;
+    batch.swap(t_aio_ctx->m_iocb_batch);
+    if (io_merge_enabled()) { merge_batch(batch); }
+    submit_iocbs(batch);
+    if (t_aio_ctx->m_iocb_batch.empty()) { t_aio_ctx->m_iocb_batch.swap(batch); }
+}
 
-    auto& metrics = iomanager.this_thread_metrics();
-    ++metrics.iface_io_batch_count;
-    metrics.iface_io_actual_count += n_issued;
-    t_aio_ctx->inc_submitted_aio(n_issued);
+void AioDriveInterface::on_merged_io_completion(std::error_code err, void* cookie) {
+    auto merged = r_cast< drive_aio_iocb* >(cookie);
+    auto iface = static_cast< AioDriveInterface* >(merged->iface);
+    for_each_merged_member(merged, [merged, iface](drive_iocb* m) {
+        m->result = merged->result;
+        iface->complete_io(r_cast< drive_aio_iocb* >(m));
+    });
+}
+
+void AioDriveInterface::merge_batch(std::vector< kernel_iocb_t* >& kiocbs) {
+    std::vector< drive_aio_iocb* > diocbs;
+    diocbs.reserve(kiocbs.size());
+    for (auto kiocb : kiocbs) {
+        diocbs.push_back(aio_thread_context::to_drive_iocb(kiocb));
+    }
 
-    // For those which we are not able to issue, do failure handling
-    for (auto i = n_issued; i < t_aio_ctx->m_cur_batch_size; ++i) {
-        handle_io_failure(r_cast< drive_aio_iocb* >(t_aio_ctx->m_iocb_batch[i]->data), errno);
+    const auto n_merged = merge_batch_ios(diocbs, [this](drive_aio_iocb* first, uint64_t size) {
+        auto merged = alloc_iocb(this, first->iodev, first->op_type, size, first->offset);
+        merged->completion = drive_comp_cb{on_merged_io_completion, (void*)merged};
+        return merged;
+    });
+    if (n_merged == 0) { return; }
+
+    kiocbs.clear();
+    for (auto diocb : diocbs) {
+        if (diocb->merged_next != nullptr) {
+            // Merged iocb is prepared only now, since its iovs are filled in after creation
+            auto kiocb = &diocb->kernel_iocb;
+            if (diocb->op_type == DriveOpType::READ) {
+                io_prep_preadv(kiocb, diocb->iodev->fd(), diocb->get_iovs(), diocb->iovcnt, diocb->offset);
+            } else {
+                io_prep_pwritev(kiocb, diocb->iodev->fd(), diocb->get_iovs(), diocb->iovcnt, diocb->offset);
+            }
+            kiocb->data = diocb;
+#ifdef __linux
+            io_set_eventfd(kiocb, t_aio_ctx->m_ev_fd);
+#endif
+        }
+        kiocbs.push_back(&diocb->kernel_iocb);
     }
-    t_aio_ctx->reset_batch();
+}
+
+void AioDriveInterface::submit_iocbs(std::vector< kernel_iocb_t* >& kiocbs) {
+    const auto nslots =
+        t_aio_ctx->can_submit_io() ? (t_aio_ctx->m_max_outstanding_ios - t_aio_ctx->m_submitted_ios) : 0;
+    const auto n_to_issue = std::min(kiocbs.size(), size_t(nslots));
+
+    long n_issued{0};
+    int submit_err{0};
+    if (n_to_issue != 0) {
+        // libaio returns the negated error instead of setting errno
+        n_issued = io_submit(t_aio_ctx->m_ioctx, n_to_issue, kiocbs.data());
+        if (n_issued < 0) {
+            submit_err = -n_issued;
+            n_issued = 0;
+        } else if (size_t(n_issued) < n_to_issue) {
+            submit_err = EAGAIN;
+        }
+
+        auto& metrics = iomanager.this_thread_metrics();
+        ++metrics.iface_io_batch_count;
+        metrics.iface_io_actual_count += n_issued;
+        t_aio_ctx->inc_submitted_aio(n_issued);
+    }
+
+    // Kernel stops at the first iocb it rejects, so the error is of that one and the rest of them are just not
+    // submitted yet. Those beyond the available slots wait in pending list.
+    for (auto i = size_t(n_issued); i < kiocbs.size(); ++i) {
+        auto diocb = aio_thread_context::to_drive_iocb(kiocbs[i]);
+        if (i < n_to_issue) {
+            handle_io_failure(diocb, (i == size_t(n_issued)) ? submit_err : EAGAIN, true /* at_submit */);
+        } else {
+            push_to_pending_list(diocb, true /* because_no_slot */);
+        }
+    }
+    kiocbs.clear();
 }
 
 void AioDriveInterface::issue_pending_ios() {
@@ -288,8 +382,24 @@ void AioDriveInterface::push_to_pending_list(drive_aio_iocb* diocb, bool because
     }
 }
 
-bool AioDriveInterface::handle_io_failure(drive_aio_iocb* diocb, int error) {
-    if (error == EAGAIN) {
+bool AioDriveInterface::handle_io_failure(drive_aio_iocb* diocb, int error, bool at_submit) {
+    if ((diocb->op_type == DriveOpType::FSYNC) && at_submit && (error == EINVAL)) {
+        // io_submit rejects IOCB_CMD_FDSYNC if kernel (< 4.18) or the file doesn't support async fdsync, do it in
+        // offload threads from now on. EINVAL reaped on completion is the error of the fsync itself.
+        if (m_fdsync_supported.exchange(false)) {
+            LOGINFOMOD(iomgr, "Async fdsync is not supported by kernel, fsyncs are done in offload threads");
+        }
+        offload_fsync(diocb);
+        return true;
+    } else if (diocb->durable && at_submit && (error == EINVAL)) {
+        // io_submit rejects RWF_DSYNC if kernel (< 4.13) doesn't support it on aio, write and datasync in offload
+        // threads from now on. EINVAL reaped on completion, like for a misaligned write, is the error of the write.
+        if (m_dsync_supported.exchange(false)) {
+            LOGINFOMOD(iomgr, "Aio RWF_DSYNC is not supported by kernel, durable writes are done in offload threads");
+        }
+        offload_durable_write(diocb);
+        return true;
+    } else if (error == EAGAIN) {
         push_to_pending_list(diocb, false /* no_slot */);
         return true;
     } else if (diocb->resubmit_cnt > IM_DYNAMIC_CONFIG(drive.max_resubmit_cnt)) {
@@ -307,22 +417,11 @@ bool AioDriveInterface::handle_io_failure(drive_aio_iocb* diocb, int error) {
 
 void AioDriveInterface::complete_io(drive_aio_iocb* diocb) {
     if (diocb->result == 0) {
-        static std::error_code success;
-        std::visit(overloaded{[&](folly::Promise< std::error_code >& p) { p.setValue(success); },
-                              [&](FiberManagerLib::Promise< std::error_code >& p) { p.setValue(success); },
-                              [&](io_interface_comp_cb_t& cb) { cb(diocb->result); }},
-                   diocb->completion);
+        diocb->complete(std::error_code{});
     } else {
-        std::visit(overloaded{[&](folly::Promise< std::error_code >& p) {
-                                  p.setValue(std::error_code{int_cast(diocb->result), std::system_category()});
-                              },
-                              [&](FiberManagerLib::Promise< std::error_code >& p) {
-                                  p.setValue(std::error_code{int_cast(diocb->result), std::system_category()});
-                              },
-                              [&](io_interface_comp_cb_t& cb) { cb(diocb->result); }},
-                   diocb->completion);
+        diocb->complete(std::error_code{int_cast(diocb->result), std::system_category()});
     }
-    delete diocb;
+    slab_delete(diocb);
 }
 
 void AioDriveInterface::submit_in_this_thread(AioDriveInterface* iface, drive_aio_iocb* diocb, bool part_of_batch) {
@@ -337,18 +436,27 @@ void AioDriveInterface::submit_in_this_thread(AioDriveInterface* iface, drive_ai
     }
 }
 
-folly::Future< std::error_code > AioDriveInterface::async_write(IODevice* iodev, const char* data, uint32_t size,
-                                                                uint64_t offset, bool part_of_batch) {
-    auto diocb = prep_iocb(this, iodev, DriveOpType::WRITE, (char*)data, size, offset);
-    diocb->completion = std::move(folly::Promise< std::error_code >{});
-    auto ret = diocb->folly_comp_promise().getFuture();
-
+void AioDriveInterface::submit_async_io(drive_aio_iocb* diocb, bool part_of_batch) {
+    if (!DriveInterface::qos_admit(diocb)) { return; }
     if (iomanager.this_reactor() != nullptr) {
         submit_in_this_thread(this, diocb, part_of_batch);
     } else {
         iomanager.run_on_forget(reactor_regex::random_worker,
                                 [this, diocb, part_of_batch]() { submit_in_this_thread(this, diocb, part_of_batch); });
     }
+}
+
+void AioDriveInterface::submit_qos_admitted(drive_iocb* iocb) {
+    submit_async_io(r_cast< drive_aio_iocb* >(iocb), false /* part_of_batch */);
+}
+
+folly::Future< std::error_code > AioDriveInterface::async_write(IODevice* iodev, const char* data, uint32_t size,
+                                                                uint64_t offset, bool part_of_batch) {
+    auto diocb = prep_iocb(this, iodev, DriveOpType::WRITE, (char*)data, size, offset);
+    diocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = diocb->folly_comp_promise().getFuture();
+
+    submit_async_io(diocb, part_of_batch);
 
     return ret;
 }
@@ -359,12 +467,7 @@ folly::Future< std::error_code > AioDriveInterface::async_read(IODevice* iodev,
     diocb->completion = std::move(folly::Promise< std::error_code >{});
     auto ret = diocb->folly_comp_promise().getFuture();
 
-    if (iomanager.this_reactor() != nullptr) {
-        submit_in_this_thread(this, diocb, part_of_batch);
-    } else {
-        iomanager.run_on_forget(reactor_regex::random_worker,
-                                [this, diocb, part_of_batch]() { submit_in_this_thread(this, diocb, part_of_batch); });
-    }
+    submit_async_io(diocb, part_of_batch);
     return ret;
 }
 
@@ -374,12 +477,7 @@ folly::Future< std::error_code > AioDriveInterface::async_writev(IODevice* iodev
     diocb->completion = std::move(folly::Promise< std::error_code >{});
     auto ret = diocb->folly_comp_promise().getFuture();
 
-    if (iomanager.this_reactor() != nullptr) {
-        submit_in_this_thread(this, diocb, part_of_batch);
-    } else {
-        iomanager.run_on_forget(reactor_regex::random_worker,
-                                [this, diocb, part_of_batch]() { submit_in_this_thread(this, diocb, part_of_batch); });
-    }
+    submit_async_io(diocb, part_of_batch);
     return ret;
 }
 
@@ -389,24 +487,211 @@ folly::Future< std::error_code > AioDriveInterface::async_readv(IODevice* iodev,
     diocb->completion = std::move(folly::Promise< std::error_code >{});
     auto ret = diocb->folly_comp_promise().getFuture();
 
-    if (iomanager.this_reactor() != nullptr) {
-        submit_in_this_thread(this, diocb, part_of_batch);
-    } else {
+    submit_async_io(diocb, part_of_batch);
+    return ret;
+}
+
+void AioDriveInterface::async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset,
+                                       const drive_comp_cb& cb, bool part_of_batch) {
+    auto diocb = prep_iocb(this, iodev, DriveOpType::WRITE, (char*)data, size, offset);
+    diocb->completion = cb;
+    submit_async_io(diocb, part_of_batch);
+}
+
+void AioDriveInterface::async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                        const drive_comp_cb& cb, bool part_of_batch) {
+    auto diocb = prep_iocb_v(this, iodev, DriveOpType::WRITE, iov, iovcnt, size, offset);
+    diocb->completion = cb;
+    submit_async_io(diocb, part_of_batch);
+}
+
+void AioDriveInterface::async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset,
+                                      const drive_comp_cb& cb, bool part_of_batch) {
+    auto diocb = prep_iocb(this, iodev, DriveOpType::READ, data, size, offset);
+    diocb->completion = cb;
+    submit_async_io(diocb, part_of_batch);
+}
+
+void AioDriveInterface::async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                       const drive_comp_cb& cb, bool part_of_batch) {
+    auto diocb = prep_iocb_v(this, iodev, DriveOpType::READ, iov, iovcnt, size, offset);
+    diocb->completion = cb;
+    submit_async_io(diocb, part_of_batch);
+}
+
+void AioDriveInterface::async_submit(std::span< const drive_io_request > reqs) {
+    if (iomanager.this_reactor() == nullptr) {
+        // Hop to the reactor once for the entire set, instead of once per request
         iomanager.run_on_forget(reactor_regex::random_worker,
-                                [this, diocb, part_of_batch]() { submit_in_this_thread(this, diocb, part_of_batch); });
+                                [this, reqs = std::vector< drive_io_request >(reqs.begin(), reqs.end())]() {
+                                    async_submit(reqs);
+                                });
+        return;
     }
-    return ret;
+
+    // Reads and writes are issued in a single io_submit, rest of the ops have their own submission path. Vector is
+    // taken out of the context, since completion of a failed io could submit again from within.
+    std::vector< kernel_iocb_t* > kiocbs;
+    kiocbs.swap(t_aio_ctx->m_submit_vec);
+    for (const auto& req : reqs) {
+        if (!req.is_valid() || ((req.op_type != DriveOpType::READ) && (req.op_type != DriveOpType::WRITE))) {
+            submit_request(req, false /* part_of_batch */);
+            continue;
+        }
+
+        drive_aio_iocb* diocb;
+        if (req.data != nullptr) {
+            diocb = prep_iocb(this, req.iodev, req.op_type, req.data, req.size, req.offset);
+        } else {
+            diocb = prep_iocb_v(this, req.iodev, req.op_type, req.iov, req.iovcnt, req.size, req.offset);
+        }
+        diocb->completion = req.cb;
+        if (!DriveInterface::qos_admit(diocb)) { continue; }
+#ifdef __linux
+        io_set_eventfd(&diocb->kernel_iocb, t_aio_ctx->m_ev_fd);
+#endif
+        kiocbs.push_back(&diocb->kernel_iocb);
+    }
+    if (!kiocbs.empty()) {
+        if (io_merge_enabled()) { merge_batch(kiocbs); }
+        submit_iocbs(kiocbs);
+    }
+    t_aio_ctx->m_submit_vec.swap(kiocbs);
 }
 
 folly::Future< std::error_code > AioDriveInterface::async_unmap(IODevice* iodev, uint32_t size, uint64_t offset,
                                                                 bool part_of_batch) {
-    RELEASE_ASSERT(0, "async_unmap is not supported for aio yet");
-    return folly::makeFuture< std::error_code >(std::error_code(ENOTSUP, std::system_category()));
+    // Linux aio has no discard op, so punch the hole in offload thread instead of blocking the reactor
+    auto diocb = alloc_iocb(this, iodev, DriveOpType::UNMAP, size, offset);
+    diocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = diocb->folly_comp_promise().getFuture();
+
+    offload_io(
+        diocb,
+        [this](drive_iocb* iocb) -> int64_t {
+            const int mode = fallocate_mode(iocb->iodev, iocb->op_type);
+            const uint64_t max_chunk = max_unmap_range_size(iocb->iodev);
+            for (uint64_t done{0}; done < iocb->size;) {
+                const uint64_t chunk = std::min(iocb->size - done, max_chunk);
+                if (::fallocate(iocb->iodev->fd(), mode, iocb->offset + done, chunk) != 0) {
+                    LOGERRORMOD(iomgr, "Error in unmap of iocb={} errno={}", iocb->to_string(), errno);
+                    return errno;
+                }
+                done += chunk;
+            }
+            return 0;
+        },
+        [this](drive_iocb* iocb) { complete_io(r_cast< drive_aio_iocb* >(iocb)); });
+    return ret;
 }
 
 folly::Future< std::error_code > AioDriveInterface::async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) {
-    RELEASE_ASSERT(0, "async_write_zero is not supported for aio yet");
-    return folly::makeFuture< std::error_code >(std::error_code(ENOTSUP, std::system_category()));
+    auto diocb = alloc_iocb(this, iodev, DriveOpType::WRITE_ZERO, size, offset);
+    diocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = diocb->folly_comp_promise().getFuture();
+    prep_write_zero_chunk(diocb);
+
+    submit_async_io(diocb, false /* part_of_batch */);
+    return ret;
+}
+
+void AioDriveInterface::prep_write_zero_chunk(drive_aio_iocb* diocb) {
+    const auto iovcnt = fill_zero_iovs(diocb->zero_iovs, expected_result(diocb));
+#ifdef __linux__
+    io_prep_pwritev(&diocb->kernel_iocb, diocb->iodev->fd(), diocb->zero_iovs.data(), iovcnt, diocb->offset);
+    diocb->kernel_iocb.data = diocb;
+#endif
+}
+
+folly::Future< std::error_code > AioDriveInterface::queue_fsync(IODevice* iodev) {
+    auto diocb = alloc_iocb(this, iodev, DriveOpType::FSYNC, 0, 0);
+    diocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = diocb->folly_comp_promise().getFuture();
+
+#ifdef __linux__
+    if (m_fdsync_supported.load(std::memory_order_relaxed)) {
+        io_prep_fdsync(&diocb->kernel_iocb, iodev->fd());
+        diocb->kernel_iocb.data = diocb;
+        submit_async_io(diocb, false /* part_of_batch */);
+        return ret;
+    }
+#endif
+    offload_fsync(diocb);
+    return ret;
+}
+
+void AioDriveInterface::offload_fsync(drive_aio_iocb* diocb) {
+    COUNTER_INCREMENT(m_metrics, offloaded_fsyncs, 1);
+    offload_io(
+        diocb,
+        [](drive_iocb* iocb) -> int64_t {
+            if (::fdatasync(iocb->iodev->fd()) != 0) {
+                LOGERRORMOD(iomgr, "Error in fsync of iocb={} errno={}", iocb->to_string(), errno);
+                return errno;
+            }
+            return 0;
+        },
+        [this](drive_iocb* iocb) { complete_io(r_cast< drive_aio_iocb* >(iocb)); });
+}
+
+void AioDriveInterface::offload_durable_write(drive_aio_iocb* diocb) {
+    COUNTER_INCREMENT(m_metrics, offloaded_durable_writes, 1);
+    offload_io(
+        diocb,
+        [this](drive_iocb* iocb) -> int64_t {
+            const auto err = iocb->has_iovs()
+                ? sync_writev(iocb->iodev, iocb->get_iovs(), iocb->iovcnt, iocb->size, iocb->offset)
+                : sync_write(iocb->iodev, iocb->get_data(), iocb->size, iocb->offset);
+            if (err) { return err.value(); }
+            if (::fdatasync(iocb->iodev->fd()) != 0) {
+                LOGERRORMOD(iomgr, "Error in datasync of durable write iocb={} errno={}", iocb->to_string(), errno);
+                return errno;
+            }
+            return 0;
+        },
+        [this](drive_iocb* iocb) { complete_io(r_cast< drive_aio_iocb* >(iocb)); });
+}
+
+uint64_t AioDriveInterface::expected_result(const drive_aio_iocb* diocb) {
+    if (diocb->op_type == DriveOpType::WRITE_ZERO) {
+        return std::min(diocb->size, static_cast< uint64_t >(max_zero_write_size));
+    }
+    return diocb->size;
+}
+
+folly::Future< std::error_code > AioDriveInterface::async_write_durable(IODevice* iodev, const char* data,
+                                                                        uint32_t size, uint64_t offset) {
+#ifdef RWF_DSYNC
+    return submit_durable(prep_iocb(this, iodev, DriveOpType::WRITE, (char*)data, size, offset));
+#else
+    return DriveInterface::async_write_durable(iodev, data, size, offset);
+#endif
+}
+
+folly::Future< std::error_code > AioDriveInterface::async_writev_durable(IODevice* iodev, const iovec* iov,
+                                                                         int iovcnt, uint32_t size, uint64_t offset) {
+#ifdef RWF_DSYNC
+    return submit_durable(prep_iocb_v(this, iodev, DriveOpType::WRITE, iov, iovcnt, size, offset));
+#else
+    return DriveInterface::async_writev_durable(iodev, iov, iovcnt, size, offset);
+#endif
+}
+
+folly::Future< std::error_code > AioDriveInterface::submit_durable(drive_aio_iocb* diocb) {
+    // Kernel completes a write with RWF_DSYNC only after the data is made durable, same as write followed by datasync
+    diocb->durable = true;
+    diocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = diocb->folly_comp_promise().getFuture();
+    if (!m_dsync_supported.load(std::memory_order_relaxed)) {
+        offload_durable_write(diocb);
+        return ret;
+    }
+
+#ifdef RWF_DSYNC
+    diocb->kernel_iocb.aio_rw_flags |= RWF_DSYNC;
+#endif
+    submit_async_io(diocb, false /* part_of_batch */);
+    return ret;
 }
 
 void AioDriveInterface::init_poll_interval_table() {
@@ -424,15 +709,49 @@ void AioDriveInterface::init_poll_interval_table() {
 }
 
 /////////////////////////// aio_thread_context /////////////////////////////////////////////////
-aio_thread_context::aio_thread_context() {
+#ifdef __linux__
+// Layout of the completion ring which io_context_t points to, it is not exported by kernel headers
+struct aio_ring {
+    unsigned id;
+    unsigned nr; // Number of io_events
+    unsigned head;
+    unsigned tail;
+    unsigned magic;
+    unsigned compat_features;
+    unsigned incompat_features;
+    unsigned header_length; // Size of aio_ring
+    struct io_event io_events[0];
+};
+static constexpr unsigned aio_ring_magic{0xa10a10a1};
+// Kernel sets AIO_RING_COMPAT_FEATURES (1) in compat_features, which readers can ignore, and AIO_RING_INCOMPAT_FEATURES
+// (0) in incompat_features, any other value there means a layout we can't read
+static constexpr unsigned aio_ring_incompat_features{0};
+
+static bool is_user_reapable(io_context_t ctx) {
+    const auto ring = r_cast< const aio_ring* >(ctx);
+    return (ring != nullptr) && (ring->magic == aio_ring_magic) &&
+        (ring->incompat_features == aio_ring_incompat_features) && (ring->header_length == sizeof(aio_ring));
+}
+#endif
+
+aio_thread_context::aio_thread_context() :
+        m_max_outstanding_ios{std::max(IM_DYNAMIC_CONFIG(aio.max_outstanding_ios), 1u)},
+        m_max_batch_iocbs{std::clamp(IM_DYNAMIC_CONFIG(aio.max_batch_iocbs), 1u, m_max_outstanding_ios)} {
+    m_events.resize(m_max_outstanding_ios);
+    m_iocb_batch.reserve(m_max_batch_iocbs);
 #ifdef __linux__
     m_ev_fd = eventfd(0, EFD_NONBLOCK);
 
-    int err = io_setup(MAX_OUTSTANDING_IO, &m_ioctx);
+    int err = io_setup(m_max_outstanding_ios, &m_ioctx);
     if (err) {
         LOGCRITICAL("io_setup failed with ret status {} errno {}", err, errno);
         folly::throwSystemError(fmt::format("io_setup failed with ret status {} errno {}", err, errno));
     }
+
+    if (IM_DYNAMIC_CONFIG(aio.user_space_reap)) {
+        m_user_reap = is_user_reapable(m_ioctx);
+        if (!m_user_reap) { LOGINFOMOD(iomgr, "Unknown aio completion ring layout, reaping through io_getevents"); }
+    }
 #elif defined(__APPLE__)
 #endif
 }
@@ -443,11 +762,34 @@ aio_thread_context::~aio_thread_context() {
     close(m_ev_fd);
 }
 
-bool aio_thread_context::can_submit_io() const { return (m_submitted_ios < MAX_OUTSTANDING_IO); }
+int aio_thread_context::reap_events() {
+#ifdef __linux__
+    if (m_user_reap) {
+        // Only this thread consumes the ring, kernel only moves the tail. Reading the events has to be ordered after
+        // reading the tail and the head update after reading the events, so that kernel doesn't overwrite them.
+        auto ring = r_cast< aio_ring* >(m_ioctx);
+        unsigned head = ring->head;
+        const unsigned tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+        int count{0};
+        while ((head != tail) && (count < s_cast< int >(m_events.size()))) {
+            m_events[count++] = ring->io_events[head];
+            head = (head + 1) % ring->nr;
+        }
+        if (count != 0) { __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE); }
+        return count;
+    }
+    return io_getevents(m_ioctx, 0, m_events.size(), m_events.data(), NULL);
+#else
+    return 0;
+#endif
+}
+
+bool aio_thread_context::can_submit_io() const { return (m_submitted_ios < m_max_outstanding_ios); }
 
 bool aio_thread_context::add_to_batch(drive_aio_iocb* diocb) {
-    m_iocb_batch[m_cur_batch_size++] = &diocb->kernel_iocb;
-    return (m_cur_batch_size == max_batch_iocb_count);
+    m_iocb_batch.push_back(&diocb->kernel_iocb);
+    return (m_iocb_batch.size() >= m_max_batch_iocbs);
 }
 
 void aio_thread_context::inc_submitted_aio(int count) {
@@ -466,8 +808,6 @@ void aio_thread_context::dec_submitted_aio() {
                                                     : AioDriveInterface::s_poll_interval_table[m_submitted_ios]);
 }
 
-void aio_thread_context::reset_batch() { m_cur_batch_size = 0; }
-
 drive_aio_iocb* aio_thread_context::to_drive_iocb(kernel_iocb_t* kiocb) {
 #ifdef __linux__
     return r_cast< drive_aio_iocb* >(kiocb->data);
@@ -44,10 +44,6 @@
 #include <iomgr/iomgr_types.hpp>
 
 namespace iomgr {
-constexpr unsigned MAX_OUTSTANDING_IO{200}; // if max outstanding IO is more than 200 then io_submit will fail.
-constexpr unsigned MAX_COMPLETIONS{MAX_OUTSTANDING_IO}; // how many completions to process in one shot
-
-static constexpr int max_batch_iocb_count = 4;
 static constexpr int max_batch_iov_cnt = IOV_MAX;
 
 #ifdef __linux__
@@ -60,22 +56,27 @@ struct drive_aio_iocb : public drive_iocb {
     drive_aio_iocb(DriveInterface* iface, IODevice* iodev, DriveOpType op_type, uint64_t size, uint64_t offset) :
             drive_iocb{iface, iodev, op_type, size, offset} {}
     kernel_iocb_t kernel_iocb;
+    std::vector< iovec > zero_iovs; // Iovs of the zero buffer covering the current chunk of write zero
 };
 
 struct IODevice;
 class IOReactor;
 struct aio_thread_context {
 public:
-    std::array< io_event, MAX_COMPLETIONS > m_events;
+    const uint32_t m_max_outstanding_ios;
+    const uint32_t m_max_batch_iocbs;
+    std::vector< io_event > m_events; // Sized to max outstanding ios, so all completions are reaped in one shot
     int m_ev_fd{0};
     io_context_t m_ioctx{0};
+    bool m_user_reap{false}; // Completions are reaped from the ring mapped to user space
     std::queue< drive_aio_iocb* > m_iocb_pending_list;
 
-    std::array< kernel_iocb_t*, max_batch_iocb_count > m_iocb_batch;
-    uint32_t m_cur_batch_size{0};
+    std::vector< kernel_iocb_t* > m_iocb_batch;
+    std::vector< kernel_iocb_t* > m_submit_vec; // Reused across vectored submissions to avoid allocation
 
     shared< IODevice > m_ev_io_dev; // fd info after registering with IOManager
     poll_cb_idx_t m_poll_cb_idx;
+    poll_cb_idx_t m_loop_end_cb_idx;
     bool m_timer_set{false};
 
     uint64_t m_submitted_ios{0};
@@ -84,11 +85,12 @@ public:
     aio_thread_context();
     ~aio_thread_context();
 
+    // Reaps the completed events into m_events and returns the count, or -errno on failure
+    int reap_events();
     bool add_to_batch(drive_aio_iocb* diocb);
     bool can_submit_io() const;
     void inc_submitted_aio(int count);
     void dec_submitted_aio();
-    void reset_batch();
     static drive_aio_iocb* to_drive_iocb(kernel_iocb_t* kiocb);
 };
 
@@ -103,6 +105,11 @@ public:
         // as a metric as of now. Once added, will remove this counter/gauge.
         REGISTER_COUNTER(retry_list_size, "Retry list size", sisl::_publish_as::publish_as_gauge);
         REGISTER_COUNTER(total_io_callbacks, "Number of times aio returned io events");
+        REGISTER_COUNTER(user_reaped_events, "Number of aio completions reaped from the ring mapped to user space");
+        REGISTER_COUNTER(syscall_reaped_events, "Number of aio completions reaped through io_getevents");
+        REGISTER_COUNTER(offloaded_fsyncs, "Number of fsyncs done in offload threads since kernel can't do it async");
+        REGISTER_COUNTER(offloaded_durable_writes,
+                         "Number of durable writes done in offload threads since kernel rejected RWF_DSYNC");
         register_me_to_farm();
     }
 
@@ -127,14 +134,24 @@ public:
                                                 bool part_of_batch = false) override;
     folly::Future< std::error_code > async_readv(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
                                                  uint64_t offset, bool part_of_batch = false) override;
+    void async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                        bool part_of_batch = false) override;
+    void async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                         const drive_comp_cb& cb, bool part_of_batch = false) override;
+    void async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                       bool part_of_batch = false) override;
+    void async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                        const drive_comp_cb& cb, bool part_of_batch = false) override;
     folly::Future< std::error_code > async_unmap(IODevice* iodev, uint32_t size, uint64_t offset,
                                                  bool part_of_batch = false) override;
-    folly::Future< std::error_code > async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset);
-    folly::Future< std::error_code > queue_fsync(IODevice* iodev) override {
-        LOGWARN("fsync on aio drive interface is not supported");
-        return folly::makeFuture< std::error_code >(std::error_code(ENOTSUP, std::system_category()));
-    }
-
+    folly::Future< std::error_code > async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) override;
+    folly::Future< std::error_code > async_write_durable(IODevice* iodev, const char* data, uint32_t size,
+                                                         uint64_t offset) override;
+    folly::Future< std::error_code > async_writev_durable(IODevice* iodev, const iovec* iov, int iovcnt,
+                                                          uint32_t size, uint64_t offset) override;
+    folly::Future< std::error_code > queue_fsync(IODevice* iodev) override;
+
+    void async_submit(std::span< const drive_io_request > reqs) override;
     virtual void submit_batch() override;
 
     void on_event_notification(IODevice* iodev, void* cookie, int event);
@@ -151,20 +168,36 @@ private:
 
     // Returns true if it is able to submit, else false
     bool submit_io(drive_aio_iocb* diocb);
+    void submit_iocbs(std::vector< kernel_iocb_t* >& kiocbs);
+    // Replaces the contiguous reads/writes of the batch with merged iocbs
+    void merge_batch(std::vector< kernel_iocb_t* >& kiocbs);
+    static void on_merged_io_completion(std::error_code err, void* cookie);
     void issue_pending_ios();
     void push_to_pending_list(drive_aio_iocb* diocb, bool because_no_slot);
 
     /* return true if it is requeued the io and it will process later
      * return false if given up and completed the io.
+     * at_submit tells if io_submit rejected it, rather than it failed on completion.
      */
-    bool handle_io_failure(drive_aio_iocb* diocb, int error);
+    bool handle_io_failure(drive_aio_iocb* diocb, int error, bool at_submit);
     void complete_io(drive_aio_iocb* diocb);
 
+    // Write zero is issued as writes of zero buffer, one chunk of max_zero_write_size at a time
+    void prep_write_zero_chunk(drive_aio_iocb* diocb);
+    static uint64_t expected_result(const drive_aio_iocb* diocb);
+
     static void submit_in_this_thread(AioDriveInterface* iface, drive_aio_iocb* diocb, bool part_of_batch);
+    void submit_async_io(drive_aio_iocb* diocb, bool part_of_batch);
+    void submit_qos_admitted(drive_iocb* iocb) override;
+    folly::Future< std::error_code > submit_durable(drive_aio_iocb* diocb);
+    void offload_fsync(drive_aio_iocb* diocb);
+    void offload_durable_write(drive_aio_iocb* diocb);
 
 private:
     static thread_local std::unique_ptr< aio_thread_context > t_aio_ctx;
     std::mutex m_open_mtx;
+    std::atomic< bool > m_fdsync_supported{true}; // Cleared once kernel rejects IOCB_CMD_FDSYNC
+    std::atomic< bool > m_dsync_supported{true};  // Cleared once kernel rejects write with RWF_DSYNC
     AioDriveInterfaceMetrics m_metrics;
 };
 } // namespace iomgr
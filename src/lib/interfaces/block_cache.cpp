@@ -0,0 +1,270 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#include <algorithm>
+#include <cstring>
+
+#include <sisl/logging/logging.h>
+#include <iomgr/iomgr.hpp>
+#include <iomgr/io_device.hpp>
+#include <iomgr/block_cache.hpp>
+
+namespace iomgr {
+// Cached blocks are only copied in and out, never used for device io, so they need no more than cache line alignment
+static constexpr size_t cache_buf_align{64};
+
+size_t BlockCache::block_key_hash::operator()(const block_key& k) const {
+    uint64_t h = (k.blkno * 0x9E3779B97F4A7C15ull) ^ r_cast< uint64_t >(k.iodev);
+    h ^= (h >> 29);
+    return s_cast< size_t >(h);
+}
+
+BlockCache::BlockCache(const std::string& name, const block_cache_params& params) :
+        m_params{params}, m_block_size{params.block_size}, m_metrics{name} {
+    RELEASE_ASSERT(((m_block_size & (m_block_size - 1)) == 0) && (m_block_size != 0),
+                   "Block cache block size={} has to be power of 2", m_block_size);
+
+    const uint32_t nshards = (params.num_shards != 0) ? params.num_shards : std::max(iomanager.num_workers(), 1u);
+    const uint64_t slots_per_shard = std::max(params.capacity / m_block_size / nshards, uint64_t{1});
+    for (uint32_t i{0}; i < nshards; ++i) {
+        auto s = std::make_unique< shard >();
+        s->slots.resize(slots_per_shard);
+        s->index.reserve(slots_per_shard);
+        m_shards.push_back(std::move(s));
+    }
+    m_metrics.attach_gather_cb(std::bind(&BlockCache::on_gather, this));
+    LOGINFOMOD(iomgr, "Block cache {} created with shards={} blocks per shard={} block size={} write policy={}", name,
+               nshards, slots_per_shard, m_block_size, enum_name(params.write_policy));
+}
+
+BlockCache::~BlockCache() {
+    for (auto& s : m_shards) {
+        for (auto& sl : s->slots) {
+            if (sl.buf != nullptr) { iomanager.iobuf_free(sl.buf); }
+        }
+    }
+}
+
+folly::Future< std::error_code > BlockCache::async_read(IODevice* iodev, char* data, uint32_t size, uint64_t offset) {
+    if (!is_aligned(offset, size)) {
+        COUNTER_INCREMENT(m_metrics, cache_bypass_ios, 1);
+        return iodev->drive_interface()->async_read(iodev, data, size, offset);
+    }
+
+    const uint64_t first_blkno = offset / m_block_size;
+    const uint64_t nblks = size / m_block_size;
+    std::vector< uint64_t > seqs(nblks);
+    uint64_t miss_first{nblks};
+    uint64_t miss_last{0};
+    for (uint64_t i{0}; i < nblks; ++i) {
+        if (!lookup(block_key{iodev, first_blkno + i}, r_cast< uint8_t* >(data) + (i * m_block_size), seqs[i])) {
+            if (miss_first == nblks) { miss_first = i; }
+            miss_last = i;
+        }
+    }
+
+    if (miss_first == nblks) {
+        m_hits.fetch_add(nblks, std::memory_order_relaxed);
+        COUNTER_INCREMENT(m_metrics, cache_hits, nblks);
+        return folly::makeFuture< std::error_code >(std::error_code{});
+    }
+
+    // Entire span from the first to the last missed block is read in one io, overwriting the hits within it
+    const uint64_t nmiss = miss_last - miss_first + 1;
+    m_hits.fetch_add(nblks - nmiss, std::memory_order_relaxed);
+    m_misses.fetch_add(nmiss, std::memory_order_relaxed);
+    COUNTER_INCREMENT(m_metrics, cache_hits, nblks - nmiss);
+    COUNTER_INCREMENT(m_metrics, cache_misses, nmiss);
+
+    char* miss_data = data + (miss_first * m_block_size);
+    return iodev->drive_interface()
+        ->async_read(iodev, miss_data, nmiss * m_block_size, offset + (miss_first * m_block_size))
+        .thenValue([this, iodev, miss_data, nmiss, miss_first, blkno = first_blkno + miss_first,
+                    seqs = std::move(seqs)](std::error_code err) {
+            if (!err) { fill(iodev, blkno, nmiss, r_cast< const uint8_t* >(miss_data), &seqs[miss_first]); }
+            return err;
+        });
+}
+
+folly::Future< std::error_code > BlockCache::async_write(IODevice* iodev, const char* data, uint32_t size,
+                                                         uint64_t offset) {
+    auto f = iodev->drive_interface()->async_write(iodev, data, size, offset);
+    if (!is_aligned(offset, size)) {
+        COUNTER_INCREMENT(m_metrics, cache_bypass_ios, 1);
+        return invalidate_on_completion(std::move(f), iodev, offset, size);
+    }
+    if (m_params.write_policy == cache_write_policy::write_around) {
+        return invalidate_on_completion(std::move(f), iodev, offset, size);
+    }
+
+    // Cache is updated only after the device has the data, until then reads see either the old or the new data, same
+    // as they would from the device
+    return std::move(f).thenValue([this, iodev, data, size, offset](std::error_code err) {
+        if (err) {
+            // Device may have any of old or new data now
+            invalidate(iodev, offset, size);
+        } else {
+            update(iodev, offset / m_block_size, size / m_block_size, r_cast< const uint8_t* >(data));
+        }
+        return err;
+    });
+}
+
+folly::Future< std::error_code > BlockCache::async_unmap(IODevice* iodev, uint32_t size, uint64_t offset) {
+    return invalidate_on_completion(iodev->drive_interface()->async_unmap(iodev, size, offset), iodev, offset, size);
+}
+
+folly::Future< std::error_code > BlockCache::async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) {
+    return invalidate_on_completion(iodev->drive_interface()->async_write_zero(iodev, size, offset), iodev, offset,
+                                    size);
+}
+
+folly::Future< std::error_code > BlockCache::invalidate_on_completion(folly::Future< std::error_code >&& f,
+                                                                      IODevice* iodev, uint64_t offset, uint64_t size) {
+    return std::move(f).thenValue([this, iodev, offset, size](std::error_code err) {
+        invalidate(iodev, offset, size);
+        return err;
+    });
+}
+
+void BlockCache::invalidate(IODevice* iodev, uint64_t offset, uint64_t size) {
+    if (size == 0) { return; }
+    const uint64_t first_blkno = offset / m_block_size;
+    const uint64_t last_blkno = (offset + size - 1) / m_block_size;
+
+    if (last_blkno - first_blkno + 1 > total_slots()) {
+        // Range is larger than the cache itself, cheaper to scan the cache than to look up every block
+        invalidate_if([iodev, first_blkno, last_blkno](const block_key& k) {
+            return (k.iodev == iodev) && (k.blkno >= first_blkno) && (k.blkno <= last_blkno);
+        });
+        return;
+    }
+
+    for (uint64_t blkno{first_blkno}; blkno <= last_blkno; ++blkno) {
+        const block_key key{iodev, blkno};
+        auto& s = shard_of(key);
+        std::unique_lock lg{s.mtx};
+        ++s.seq;
+        if (auto it = s.index.find(key); it != s.index.end()) { drop(s, it->second); }
+    }
+}
+
+void BlockCache::invalidate_device(IODevice* iodev) {
+    invalidate_if([iodev](const block_key& k) { return (k.iodev == iodev); });
+}
+
+void BlockCache::invalidate_if(const std::function< bool(const block_key&) >& pred) {
+    for (auto& s : m_shards) {
+        std::unique_lock lg{s->mtx};
+        ++s->seq;
+        for (uint32_t idx{0}; idx < s->slots.size(); ++idx) {
+            if (s->slots[idx].valid && pred(s->slots[idx].key)) { drop(*s, idx); }
+        }
+    }
+}
+
+double BlockCache::hit_ratio() const {
+    const uint64_t hits = m_hits.load(std::memory_order_relaxed);
+    const uint64_t total = hits + m_misses.load(std::memory_order_relaxed);
+    return (total == 0) ? 0.0 : (double)hits / total;
+}
+
+BlockCache::shard& BlockCache::shard_of(const block_key& key) {
+    return *m_shards[block_key_hash{}(key) % m_shards.size()];
+}
+
+bool BlockCache::lookup(const block_key& key, uint8_t* dst, uint64_t& seq) {
+    auto& s = shard_of(key);
+    std::unique_lock lg{s.mtx};
+    seq = s.seq;
+    const auto it = s.index.find(key);
+    if (it == s.index.end()) { return false; }
+
+    auto& sl = s.slots[it->second];
+    std::memcpy(dst, sl.buf, m_block_size);
+    sl.referenced = true;
+    return true;
+}
+
+void BlockCache::fill(IODevice* iodev, uint64_t first_blkno, uint64_t nblks, const uint8_t* data,
+                      const uint64_t* seqs) {
+    for (uint64_t i{0}; i < nblks; ++i) {
+        const block_key key{iodev, first_blkno + i};
+        auto& s = shard_of(key);
+        std::unique_lock lg{s.mtx};
+        if (s.seq == seqs[i]) { insert(s, key, data + (i * m_block_size)); }
+    }
+}
+
+void BlockCache::update(IODevice* iodev, uint64_t first_blkno, uint64_t nblks, const uint8_t* data) {
+    for (uint64_t i{0}; i < nblks; ++i) {
+        const block_key key{iodev, first_blkno + i};
+        auto& s = shard_of(key);
+        std::unique_lock lg{s.mtx};
+        ++s.seq;
+        insert(s, key, data + (i * m_block_size));
+    }
+}
+
+void BlockCache::insert(shard& s, const block_key& key, const uint8_t* src) {
+    uint32_t idx;
+    if (auto it = s.index.find(key); it != s.index.end()) {
+        idx = it->second;
+    } else {
+        idx = evict_one(s);
+        auto& sl = s.slots[idx];
+        if (sl.buf == nullptr) { sl.buf = iomanager.iobuf_alloc(cache_buf_align, m_block_size); }
+        sl.key = key;
+        sl.valid = true;
+        sl.referenced = false;
+        s.index.emplace(key, idx);
+        m_used_blocks.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::memcpy(s.slots[idx].buf, src, m_block_size);
+}
+
+uint32_t BlockCache::evict_one(shard& s) {
+    // CLOCK: hand clears the referenced bit of the blocks it passes and takes the first one which is not referenced,
+    // so it finds one within two rounds at most
+    while (true) {
+        const uint32_t idx = s.hand;
+        s.hand = (s.hand + 1) % s.slots.size();
+
+        auto& sl = s.slots[idx];
+        if (!sl.valid) { return idx; }
+        if (sl.referenced) {
+            sl.referenced = false;
+            continue;
+        }
+        s.index.erase(sl.key);
+        sl.valid = false;
+        m_used_blocks.fetch_sub(1, std::memory_order_relaxed);
+        COUNTER_INCREMENT(m_metrics, cache_evictions, 1);
+        return idx;
+    }
+}
+
+void BlockCache::drop(shard& s, uint32_t idx) {
+    auto& sl = s.slots[idx];
+    s.index.erase(sl.key);
+    sl.valid = false;
+    sl.referenced = false;
+    m_used_blocks.fetch_sub(1, std::memory_order_relaxed);
+    COUNTER_INCREMENT(m_metrics, cache_invalidations, 1);
+}
+
+void BlockCache::on_gather() {
+    GAUGE_UPDATE(m_metrics, cache_hit_ratio_pct, s_cast< int64_t >(hit_ratio() * 100));
+    GAUGE_UPDATE(m_metrics, cache_used_bytes, used_bytes());
+}
+} // namespace iomgr
@@ -17,6 +17,7 @@
 #include <fstream>
 #include <fcntl.h>
 #include <linux/fs.h>
+#include <linux/falloc.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -31,11 +32,13 @@
 #include <fmt/format.h>
 #include <sisl/flip/flip.hpp>
 #include <boost/algorithm/string.hpp>
+#include <folly/executors/thread_factory/NamedThreadFactory.h>
 
 #include <iomgr/iomgr.hpp>
 #include <iomgr/iomgr_flip.hpp>
 #include <iomgr/drive_interface.hpp>
 #include "interfaces/kernel_drive_interface.hpp"
+#include "interfaces/drive_qos.hpp"
 #include "interfaces/spdk_drive_interface.hpp"
 #include "iomgr_config.hpp"
 #include "reactor/reactor.hpp"
@@ -107,6 +110,20 @@ static uint64_t get_max_write_zeros(const std::string& devname) {
     return max_zeros;
 }
 
+static uint64_t get_max_discard(const std::string& devname) {
+    uint64_t max_discard{0};
+    const auto maj_min{get_major_minor(devname)};
+    if (!maj_min.empty()) {
+        const auto p{fmt::format("/sys/dev/block/{}/queue/discard_max_bytes", maj_min)};
+        if (auto max_discard_file = std::ifstream(p); max_discard_file.is_open()) {
+            max_discard_file >> max_discard;
+        } else {
+            LOGERROR("Unable to open sys path={} to get discard_max_bytes, assuming 0", p);
+        }
+    }
+    return max_discard;
+}
+
 #ifdef MEGACLI_OPTION_ENABLED
 // NOTE: This piece of code is taken from stackoverflow
 // https://stackoverflow.com/questions/478898/how-do-i-execute-a-command-and-get-the-output-of-the-command-within-c-using-po
@@ -278,6 +295,109 @@ io_device_ptr DriveInterface::open_dev(const std::string& dev_name, int oflags)
 
 size_t DriveInterface::get_size(IODevice* iodev) { return iodev->drive_interface()->get_dev_size(iodev); }
 
+folly::Future< std::error_code > DriveInterface::async_write_durable(IODevice* iodev, const char* data, uint32_t size,
+                                                                     uint64_t offset) {
+    return async_write(iodev, data, size, offset).thenValue([this, iodev](std::error_code err) {
+        return err ? folly::makeFuture< std::error_code >(std::move(err)) : queue_fsync(iodev);
+    });
+}
+
+folly::Future< std::error_code > DriveInterface::async_writev_durable(IODevice* iodev, const iovec* iov, int iovcnt,
+                                                                      uint32_t size, uint64_t offset) {
+    return async_writev(iodev, iov, iovcnt, size, offset).thenValue([this, iodev](std::error_code err) {
+        return err ? folly::makeFuture< std::error_code >(std::move(err)) : queue_fsync(iodev);
+    });
+}
+
+void DriveInterface::async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset,
+                                    const drive_comp_cb& cb, bool part_of_batch) {
+    async_write(iodev, data, size, offset, part_of_batch).thenValue([cb](std::error_code err) {
+        cb.fn(err, cb.cookie);
+    });
+}
+
+void DriveInterface::async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                     const drive_comp_cb& cb, bool part_of_batch) {
+    async_writev(iodev, iov, iovcnt, size, offset, part_of_batch).thenValue([cb](std::error_code err) {
+        cb.fn(err, cb.cookie);
+    });
+}
+
+void DriveInterface::async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset,
+                                   const drive_comp_cb& cb, bool part_of_batch) {
+    async_read(iodev, data, size, offset, part_of_batch).thenValue([cb](std::error_code err) {
+        cb.fn(err, cb.cookie);
+    });
+}
+
+void DriveInterface::async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                                    const drive_comp_cb& cb, bool part_of_batch) {
+    async_readv(iodev, iov, iovcnt, size, offset, part_of_batch).thenValue([cb](std::error_code err) {
+        cb.fn(err, cb.cookie);
+    });
+}
+
+bool drive_io_request::is_valid() const {
+    if ((iodev == nullptr) || (cb.fn == nullptr)) { return false; }
+    switch (op_type) {
+    case DriveOpType::WRITE:
+    case DriveOpType::READ:
+        return (size != 0) && ((data != nullptr) || ((iov != nullptr) && (iovcnt > 0)));
+    case DriveOpType::UNMAP:
+    case DriveOpType::WRITE_ZERO:
+        return (size != 0);
+    case DriveOpType::FSYNC:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void DriveInterface::async_submit(std::span< const drive_io_request > reqs) {
+    for (const auto& req : reqs) {
+        submit_request(req, false /* part_of_batch */);
+    }
+}
+
+void DriveInterface::submit_request(const drive_io_request& req, bool part_of_batch) {
+    if (!req.is_valid()) {
+        LOGWARNMOD(iomgr, "Invalid drive io request op={} size={} offset={}", enum_name(req.op_type), req.size,
+                   req.offset);
+        if (req.cb.fn) { req.cb.fn(std::error_code(EINVAL, std::generic_category()), req.cb.cookie); }
+        return;
+    }
+
+    const auto cb = req.cb;
+    const auto deliver = [cb](std::error_code err) { cb.fn(err, cb.cookie); };
+    switch (req.op_type) {
+    case DriveOpType::WRITE:
+        if (req.data) {
+            async_write_cb(req.iodev, req.data, req.size, req.offset, cb, part_of_batch);
+        } else {
+            async_writev_cb(req.iodev, req.iov, req.iovcnt, req.size, req.offset, cb, part_of_batch);
+        }
+        break;
+    case DriveOpType::READ:
+        if (req.data) {
+            async_read_cb(req.iodev, req.data, req.size, req.offset, cb, part_of_batch);
+        } else {
+            async_readv_cb(req.iodev, req.iov, req.iovcnt, req.size, req.offset, cb, part_of_batch);
+        }
+        break;
+    case DriveOpType::UNMAP:
+        async_unmap(req.iodev, req.size, req.offset, part_of_batch).thenValue(deliver);
+        break;
+    case DriveOpType::WRITE_ZERO:
+        async_write_zero(req.iodev, req.size, req.offset).thenValue(deliver);
+        break;
+    case DriveOpType::FSYNC:
+        queue_fsync(req.iodev).thenValue(deliver);
+        break;
+    default:
+        break;
+    }
+}
+
 void DriveInterface::increment_outstanding_counter(drive_iocb* iocb) {
     switch (iocb->op_type) {
     case DriveOpType::READ:
@@ -327,6 +447,32 @@ void DriveInterface::decrement_outstanding_counter(drive_iocb* iocb) {
     --(iomanager.this_thread_metrics().outstanding_ops);
 }
 
+static thread_local io_class t_io_class{io_class::normal};
+
+void DriveInterface::set_thread_io_class(io_class cls) { t_io_class = cls; }
+io_class DriveInterface::thread_io_class() { return t_io_class; }
+
+static std::mutex s_qos_mtx;
+
+void DriveInterface::set_qos(IODevice* iodev, const drive_qos_params& params) {
+    std::unique_lock lg{s_qos_mtx};
+    if (iodev->qos == nullptr) { iodev->qos = std::make_shared< DriveQoS >(iodev); }
+    iodev->qos->set_params(params);
+}
+
+void DriveInterface::stop_qos(IODevice* iodev) {
+    // QoS itself lives as long as the device, since ios admitted by it can still be completing
+    std::unique_lock lg{s_qos_mtx};
+    if (iodev->qos != nullptr) { iodev->qos->stop(); }
+}
+
+bool DriveInterface::qos_admit(drive_iocb* iocb) {
+    // Fsync carries no data and ordering it behind the held back writes would only delay their durability
+    const auto& qos = iocb->iodev->qos;
+    if ((qos == nullptr) || iocb->qos_admitted || (iocb->op_type == DriveOpType::FSYNC)) { return true; }
+    return qos->admit(iocb);
+}
+
 #ifdef _PRERELEASE
 bool DriveInterface::inject_delay_if_needed(drive_iocb* iocb, std::function< void(drive_iocb*) > delayed_cb) {
     auto closure = [iocb, cb = std::move(delayed_cb)]() {
@@ -406,17 +552,20 @@ void KernelDriveInterface::init_write_zero_buf(const std::string& devname, const
 #elif
     m_max_write_zeros = 0;
 #endif
+    if (((dev_type == drive_type::block_nvme) || (dev_type == drive_type::block_hdd)) &&
+        (m_max_discard == std::numeric_limits< uint64_t >::max())) {
+        m_max_discard = get_max_discard(devname);
+    }
 
-    if (m_max_write_zeros == 0) {
-        if (!m_zero_buf) {
-            m_zero_buf = std::unique_ptr< uint8_t, std::function< void(uint8_t* const) > >{
-                sisl::AlignedAllocator::allocator().aligned_alloc(DriveInterface::get_attributes(devname).align_size,
-                                                                  max_buf_size, sisl::buftag::common),
-                [](uint8_t* const ptr) {
-                    if (ptr) sisl::AlignedAllocator::allocator().aligned_free(ptr, sisl::buftag::common);
-                }};
-            if (m_zero_buf) std::fill(m_zero_buf.get(), m_zero_buf.get() + max_buf_size, 0);
-        }
+    // Zero buffer is needed even if zeros are written by ioctl, since async write zeros are issued as writes of it
+    if (!m_zero_buf) {
+        m_zero_buf = std::unique_ptr< uint8_t, std::function< void(uint8_t* const) > >{
+            sisl::AlignedAllocator::allocator().aligned_alloc(DriveInterface::get_attributes(devname).align_size,
+                                                              max_buf_size, sisl::buftag::common),
+            [](uint8_t* const ptr) {
+                if (ptr) sisl::AlignedAllocator::allocator().aligned_free(ptr, sisl::buftag::common);
+            }};
+        if (m_zero_buf) std::fill(m_zero_buf.get(), m_zero_buf.get() + max_buf_size, 0);
     }
 }
 
@@ -544,19 +693,11 @@ std::error_code KernelDriveInterface::write_zero_writev(IODevice* iodev, uint64_
     uint64_t total_sz_written = 0;
     std::error_code ret;
 
+    std::vector< iovec > iov;
     while (total_sz_written < size) {
         const uint64_t sz_to_write{(size - total_sz_written) > max_zero_write_size ? max_zero_write_size
                                                                                    : (size - total_sz_written)};
-
-        const auto iovcnt{(sz_to_write - 1) / max_buf_size + 1};
-
-        std::vector< iovec > iov(iovcnt);
-        for (uint32_t i = 0; i < iovcnt; ++i) {
-            iov[i].iov_base = m_zero_buf.get();
-            iov[i].iov_len = max_buf_size;
-        }
-
-        iov[iovcnt - 1].iov_len = sz_to_write - (max_buf_size * (iovcnt - 1));
+        const auto iovcnt = fill_zero_iovs(iov, sz_to_write);
 
         // returned written sz already asserted in sync_writev;
         ret = sync_writev(iodev, &(iov[0]), iovcnt, sz_to_write, offset + total_sz_written);
@@ -570,4 +711,59 @@ std::error_code KernelDriveInterface::write_zero_writev(IODevice* iodev, uint64_
     DEBUG_ASSERT_EQ(total_sz_written, size, "write zero couldn't completely zero out");
     return ret;
 }
+uint32_t KernelDriveInterface::fill_zero_iovs(std::vector< iovec >& iovs, uint64_t size) const {
+    DEBUG_ASSERT_LE(size, max_zero_write_size, "Zero iovs can't cover more than max_zero_write_size");
+    const uint32_t iovcnt = (size - 1) / max_buf_size + 1;
+
+    iovs.resize(iovcnt);
+    for (uint32_t i = 0; i < iovcnt; ++i) {
+        iovs[i].iov_base = m_zero_buf.get();
+        iovs[i].iov_len = max_buf_size;
+    }
+    iovs[iovcnt - 1].iov_len = size - (max_buf_size * (iovcnt - 1));
+    return iovcnt;
+}
+
+uint64_t KernelDriveInterface::max_zero_range_size(const IODevice* iodev) const {
+    return ((iodev->dtype == drive_type::block_nvme) && (m_max_write_zeros != 0)) ? m_max_write_zeros
+                                                                                   : max_zero_write_size;
+}
+
+uint64_t KernelDriveInterface::max_unmap_range_size(const IODevice* iodev) const {
+    const bool is_block = (iodev->dtype == drive_type::block_nvme) || (iodev->dtype == drive_type::block_hdd);
+    return (is_block && (m_max_discard != 0) && (m_max_discard != std::numeric_limits< uint64_t >::max()))
+        ? m_max_discard
+        : max_zero_write_size;
+}
+
+int KernelDriveInterface::fallocate_mode(const IODevice* iodev, DriveOpType op_type) {
+    const bool is_block = (iodev->dtype == drive_type::block_nvme) || (iodev->dtype == drive_type::block_hdd);
+    if (op_type == DriveOpType::UNMAP) {
+        // On block devices, punching hole with NO_HIDE_STALE is a discard, without it, it becomes a zero out
+        return FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE | (is_block ? FALLOC_FL_NO_HIDE_STALE : 0);
+    } else {
+        DEBUG_ASSERT_EQ(op_type, DriveOpType::WRITE_ZERO, "Unexpected op type for fallocate");
+        return FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE;
+    }
+}
+
+void KernelDriveInterface::offload_io(drive_iocb* iocb, std::function< int64_t(drive_iocb*) >&& blocking_op,
+                                      std::function< void(drive_iocb*) >&& done_cb) {
+    std::call_once(m_offload_init_flag, [this]() {
+        m_offload_executor = std::make_unique< folly::CPUThreadPoolExecutor >(
+            IM_DYNAMIC_CONFIG(drive.num_offload_threads),
+            std::make_shared< folly::NamedThreadFactory >("kdrive_offload"));
+    });
+
+    // Completion is delivered back on the reactor which submitted it, so that interface thread context is intact
+    auto const submit_reactor = iomanager.this_reactor();
+    m_offload_executor->add([iocb, submit_reactor, op = std::move(blocking_op), cb = std::move(done_cb)]() {
+        iocb->result = op(iocb);
+        if (submit_reactor == nullptr) {
+            cb(iocb);
+        } else {
+            iomanager.run_on_forget(submit_reactor->main_fiber(), [iocb, cb]() { cb(iocb); });
+        }
+    });
+}
 } // namespace iomgr
@@ -0,0 +1,70 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#include <sys/uio.h>
+#include <algorithm>
+#include <climits>
+
+#include <iomgr/iomgr.hpp>
+#include "interfaces/drive_io_merge.hpp"
+#include "iomgr_config.hpp"
+
+namespace iomgr {
+bool io_merge_enabled() { return IM_DYNAMIC_CONFIG(drive.merge_batch_ios); }
+
+uint32_t merged_iov_count(const drive_iocb* iocb) { return iocb->has_iovs() ? s_cast< uint32_t >(iocb->iovcnt) : 1; }
+
+bool can_merge_io(const drive_iocb* prev, const drive_iocb* next, uint32_t run_iovcnt, uint64_t run_size) {
+    if ((next->iodev != prev->iodev) || (next->iface != prev->iface) || (next->op_type != prev->op_type)) {
+        return false;
+    }
+    if (((next->op_type != DriveOpType::READ) && (next->op_type != DriveOpType::WRITE)) || prev->durable ||
+        next->durable) {
+        return false;
+    }
+    if (next->offset != prev->offset + prev->size) { return false; }
+
+    const uint32_t max_iovs = std::min(IM_DYNAMIC_CONFIG(drive.merge_max_iovs), uint32_t(IOV_MAX));
+    return (run_iovcnt + merged_iov_count(next) <= max_iovs) &&
+        (run_size + next->size <= IM_DYNAMIC_CONFIG(drive.merge_max_size));
+}
+
+void fill_merged_iovs(drive_iocb* merged) {
+    std::vector< iovec > iovs;
+    auto add_iov = [&iovs](void* base, size_t len) {
+        // Members whose buffers are back to back in memory become one iov
+        if (!iovs.empty() && ((uint8_t*)iovs.back().iov_base + iovs.back().iov_len == (uint8_t*)base)) {
+            iovs.back().iov_len += len;
+        } else {
+            iovs.push_back(iovec{base, len});
+        }
+    };
+
+    for (auto m = merged->merged_next; m != nullptr; m = m->merged_next) {
+        if (m->has_iovs()) {
+            const auto m_iovs = m->get_iovs();
+            for (int i{0}; i < m->iovcnt; ++i) {
+                add_iov(m_iovs[i].iov_base, m_iovs[i].iov_len);
+            }
+        } else {
+            add_iov((void*)m->get_data(), m->size);
+        }
+    }
+    merged->set_iovs(iovs.data(), s_cast< int >(iovs.size()));
+}
+
+void update_merge_metrics(DriveInterface* iface, uint32_t merged, uint32_t members) {
+    COUNTER_INCREMENT(iface->get_metrics(), merged_ios, merged);
+    COUNTER_INCREMENT(iface->get_metrics(), merged_member_ios, members);
+}
+} // namespace iomgr
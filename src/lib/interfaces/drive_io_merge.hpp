@@ -0,0 +1,82 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include <iomgr/drive_interface.hpp>
+
+namespace iomgr {
+// Merging of the batched ios before they are issued. A run of reads or writes of a batch, each starting where the
+// previous one ends on the same device, is issued as one vectored io within the configured iov count and size. Merged
+// io is a new iocb of the interface, whose member ios are chained through merged_next and are completed by the
+// interface once the merged io completes.
+bool io_merge_enabled();
+
+// Replaces the mergeable runs of iocbs with the merged iocb created by alloc_merged(first, size), whose iovs are
+// then filled in from the members. Returns the number of merged iocbs created.
+template < typename T, typename AllocFn >
+uint32_t merge_batch_ios(std::vector< T* >& iocbs, AllocFn&& alloc_merged);
+
+// Calls fn on each member of the merged io, in submission order. Member is unlinked before fn, so fn can free it.
+template < typename Fn >
+void for_each_merged_member(drive_iocb* merged, Fn&& fn) {
+    for (auto m = merged->merged_next; m != nullptr;) {
+        auto next = m->merged_next;
+        m->merged_next = nullptr;
+        fn(m);
+        m = next;
+    }
+    merged->merged_next = nullptr;
+}
+
+//////////////////////////////////////// Implementation ////////////////////////////////////////
+bool can_merge_io(const drive_iocb* prev, const drive_iocb* next, uint32_t run_iovcnt, uint64_t run_size);
+uint32_t merged_iov_count(const drive_iocb* iocb);
+void fill_merged_iovs(drive_iocb* merged);
+void update_merge_metrics(DriveInterface* iface, uint32_t merged, uint32_t members);
+
+template < typename T, typename AllocFn >
+uint32_t merge_batch_ios(std::vector< T* >& iocbs, AllocFn&& alloc_merged) {
+    uint32_t n_merged{0};
+    uint32_t n_members{0};
+    size_t out{0};
+    for (size_t i{0}; i < iocbs.size();) {
+        uint64_t run_size = iocbs[i]->size;
+        uint32_t run_iovcnt = merged_iov_count(iocbs[i]);
+        size_t j{i + 1};
+        while ((j < iocbs.size()) && can_merge_io(iocbs[j - 1], iocbs[j], run_iovcnt, run_size)) {
+            run_size += iocbs[j]->size;
+            run_iovcnt += merged_iov_count(iocbs[j]);
+            iocbs[j - 1]->merged_next = iocbs[j];
+            ++j;
+        }
+
+        if (j - i == 1) {
+            iocbs[out++] = iocbs[i];
+        } else {
+            T* merged = alloc_merged(iocbs[i], run_size);
+            merged->merged_next = iocbs[i];
+            fill_merged_iovs(merged);
+            iocbs[out++] = merged;
+            ++n_merged;
+            n_members += s_cast< uint32_t >(j - i);
+        }
+        i = j;
+    }
+    iocbs.resize(out);
+    if (n_merged != 0) { update_merge_metrics(iocbs[0]->iface, n_merged, n_members); }
+    return n_merged;
+}
+} // namespace iomgr
@@ -15,6 +15,9 @@
 
 #include <iomgr/iomgr.hpp>
 #include <iomgr/drive_interface.hpp>
+#include "interfaces/drive_qos.hpp"
+#include "interfaces/iocb_slab.hpp"
+#include "iomgr_config.hpp"
 
 namespace iomgr {
 
@@ -26,16 +29,39 @@ drive_iocb::drive_iocb(DriveInterface* iface, IODevice* iodev, DriveOpType op_ty
     initiating_reactor = iomanager.this_reactor();
     user_data.emplace< 0 >();
     op_start_time = Clock::now();
+    ioclass = DriveInterface::thread_io_class();
 }
 
+void drive_iocb::large_iov_deleter::operator()(iovec* iovs) const { SlabCache::free((void*)iovs); }
+
 void drive_iocb::set_iovs(const iovec* iovs, const int count) {
     iovcnt = count;
-    if (count > inlined_iov_count) { user_data = std::unique_ptr< iovec[] >(new iovec[count]); }
+    if (count > inlined_iov_count) {
+        // Round up to power of 2 iovs, so that there are only few size classes to cache
+        uint32_t nslots = 2 * inlined_iov_count;
+        while (nslots < s_cast< uint32_t >(count)) {
+            nslots <<= 1;
+        }
+        user_data = large_iov_array{r_cast< iovec* >(
+            SlabCache::alloc(nslots * sizeof(iovec), IM_DYNAMIC_CONFIG(drive.large_iov_cache_count)))};
+    }
     std::memcpy(reinterpret_cast< void* >(get_iovs()), reinterpret_cast< const void* >(iovs), count * sizeof(iovec));
 }
 
 void drive_iocb::set_data(char* data) { user_data = data; }
 
+void drive_iocb::complete(const std::error_code& err) {
+    if (qos_admitted) {
+        qos_admitted = false;
+        iodev->qos->on_complete(this);
+    }
+    std::visit(overloaded{[&](folly::Promise< std::error_code >& p) { p.setValue(err); },
+                          [&](FiberManagerLib::Promise< std::error_code >& p) { p.setValue(err); },
+                          [&](io_interface_comp_cb_t& cb) { cb(result); },
+                          [&](drive_comp_cb& cb) { cb.fn(err, cb.cookie); }},
+               completion);
+}
+
 iovec* drive_iocb::get_iovs() const {
     if (std::holds_alternative< inline_iov_array >(user_data)) {
         return const_cast< iovec* >(&(std::get< inline_iov_array >(user_data)[0]));
@@ -111,4 +137,4 @@ std::string drive_iocb::to_string() const {
     }
     return str;
 }
-} // namespace iomgr
\ No newline at end of file
+} // namespace iomgr
@@ -0,0 +1,235 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#include <algorithm>
+#include <chrono>
+
+#include <fmt/format.h>
+#include <iomgr/iomgr.hpp>
+#include <iomgr/io_device.hpp>
+#include "interfaces/drive_qos.hpp"
+#include "iomgr_config.hpp"
+
+namespace iomgr {
+// Virtual time charged for an io is in the units of this size, so that small ios are not charged below one unit
+static constexpr uint64_t qos_cost_unit{4096};
+
+DriveQoS::DriveQoS(IODevice* iodev) : m_iodev{iodev}, m_last_refill{Clock::now()} {
+    for (uint32_t i{0}; i < num_io_classes; ++i) {
+        m_classes[i].metrics =
+            std::make_unique< DriveQoSMetrics >(fmt::format("{}_{}", iodev->devname, enum_name(io_class(i))));
+    }
+}
+
+DriveQoS::~DriveQoS() {
+    if (m_refill_timer != null_timer_handle) { iomanager.cancel_timer(m_refill_timer, false); }
+}
+
+void DriveQoS::set_params(const drive_qos_params& params) {
+    std::vector< drive_iocb* > admitted;
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_stopped) { return; }
+        refill();
+        m_params = params;
+        for (auto& w : m_params.weights) {
+            w = std::max(w, 1u);
+        }
+
+        // Bucket whose limit is changed starts full, so that ios are not held back until the first refill
+        const uint64_t burst_us = IM_DYNAMIC_CONFIG(drive.qos_burst_us);
+        if (m_iops_bucket.rate != params.iops_limit) {
+            m_iops_bucket.rate = params.iops_limit;
+            m_iops_bucket.tokens = 0;
+            m_iops_bucket.refill(burst_us * 1000, burst_us);
+        }
+        if (m_bw_bucket.rate != params.bw_limit) {
+            m_bw_bucket.rate = params.bw_limit;
+            m_bw_bucket.tokens = 0;
+            m_bw_bucket.refill(burst_us * 1000, burst_us);
+        }
+        collect_admitted(admitted);
+    }
+    LOGINFOMOD(iomgr, "QoS of device {} set to iops_limit={} bw_limit={} weights=[{},{},{}] max_depth=[{},{},{}]",
+               m_iodev->devname, params.iops_limit, params.bw_limit, m_params.weights[0], m_params.weights[1],
+               m_params.weights[2], params.max_depth[0], params.max_depth[1], params.max_depth[2]);
+    update_refill_timer();
+    dispatch(admitted);
+}
+
+void DriveQoS::stop() {
+    std::vector< drive_iocb* > held;
+    {
+        std::unique_lock lg{m_mtx};
+        m_stopped = true;
+        for (auto& c : m_classes) {
+            while (!c.waitq.empty()) {
+                held.push_back(c.waitq.front());
+                c.waitq.pop_front();
+                COUNTER_DECREMENT(*c.metrics, qos_waiting_ios, 1);
+            }
+        }
+        m_waiting = 0;
+    }
+    update_refill_timer();
+
+    // Held back ios are not charged, so their completion doesn't come back to QoS
+    LOGINFOMOD(iomgr, "QoS of device {} stopped, issuing {} held back ios", m_iodev->devname, held.size());
+    dispatch(held);
+}
+
+bool DriveQoS::admit(drive_iocb* iocb) {
+    const uint32_t cls = s_cast< uint32_t >(iocb->ioclass);
+    auto& c = m_classes[cls];
+    std::vector< drive_iocb* > admitted;
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_stopped) { return true; }
+        refill();
+
+        // Class which was idle can't claim the share it didn't use, it competes from where the others are now
+        if (c.waitq.empty()) { c.vtime = std::max(c.vtime, m_vtime_floor); }
+        if ((m_waiting == 0) && can_admit(c, cls)) {
+            charge(c, cls, iocb);
+            return true;
+        }
+
+        c.waitq.push_back(iocb);
+        ++m_waiting;
+        COUNTER_INCREMENT(*c.metrics, qos_queued_ios, 1);
+        COUNTER_INCREMENT(*c.metrics, qos_waiting_ios, 1);
+        collect_admitted(admitted);
+    }
+    dispatch(admitted);
+    return false;
+}
+
+void DriveQoS::on_complete(drive_iocb* iocb) {
+    auto& c = m_classes[s_cast< uint32_t >(iocb->ioclass)];
+    std::vector< drive_iocb* > admitted;
+    {
+        std::unique_lock lg{m_mtx};
+        --c.outstanding;
+        COUNTER_DECREMENT(*c.metrics, qos_outstanding_ios, 1);
+        if (m_waiting != 0) {
+            refill();
+            collect_admitted(admitted);
+        }
+    }
+    dispatch(admitted);
+}
+
+void DriveQoS::pump() {
+    std::vector< drive_iocb* > admitted;
+    {
+        std::unique_lock lg{m_mtx};
+        if (m_waiting == 0) { return; }
+        refill();
+        collect_admitted(admitted);
+    }
+    dispatch(admitted);
+}
+
+bool DriveQoS::can_admit(const class_state& c, uint32_t cls) const {
+    if ((m_params.max_depth[cls] != 0) && (c.outstanding >= m_params.max_depth[cls])) { return false; }
+    return m_iops_bucket.available() && m_bw_bucket.available();
+}
+
+void DriveQoS::charge(class_state& c, uint32_t cls, drive_iocb* iocb) {
+    m_vtime_floor = std::max(m_vtime_floor, c.vtime);
+    c.vtime += ((std::max(iocb->size, qos_cost_unit) / qos_cost_unit) * 1024) / m_params.weights[cls];
+    ++c.outstanding;
+    iocb->qos_admitted = true;
+
+    m_iops_bucket.consume(1);
+    if ((iocb->op_type == DriveOpType::READ) || (iocb->op_type == DriveOpType::WRITE)) {
+        m_bw_bucket.consume(iocb->size);
+    }
+    COUNTER_INCREMENT(*c.metrics, qos_ios, 1);
+    COUNTER_INCREMENT(*c.metrics, qos_outstanding_ios, 1);
+}
+
+void DriveQoS::token_bucket::refill(uint64_t elapsed_ns, uint64_t burst_us) {
+    if (rate == 0) { return; }
+    const double burst = std::max(1.0, (double)rate * burst_us / 1000000.0);
+    tokens = std::min(burst, tokens + ((double)rate * elapsed_ns / 1000000000.0));
+}
+
+void DriveQoS::refill() {
+    if ((m_iops_bucket.rate == 0) && (m_bw_bucket.rate == 0)) { return; }
+
+    const auto now = Clock::now();
+    const uint64_t elapsed_ns = std::chrono::duration_cast< std::chrono::nanoseconds >(now - m_last_refill).count();
+    m_last_refill = now;
+
+    const uint64_t burst_us = IM_DYNAMIC_CONFIG(drive.qos_burst_us);
+    m_iops_bucket.refill(elapsed_ns, burst_us);
+    m_bw_bucket.refill(elapsed_ns, burst_us);
+}
+
+void DriveQoS::collect_admitted(std::vector< drive_iocb* >& out) {
+    while (m_waiting != 0) {
+        // Among the classes with ios held back and room under their depth limit, the one lagging most in virtual
+        // time goes next
+        class_state* next{nullptr};
+        uint32_t next_cls{0};
+        for (uint32_t cls{0}; cls < num_io_classes; ++cls) {
+            auto& c = m_classes[cls];
+            if (c.waitq.empty() || !can_admit(c, cls)) { continue; }
+            if ((next == nullptr) || (c.vtime < next->vtime)) {
+                next = &c;
+                next_cls = cls;
+            }
+        }
+        if (next == nullptr) { break; }
+
+        auto iocb = next->waitq.front();
+        next->waitq.pop_front();
+        --m_waiting;
+        COUNTER_DECREMENT(*next->metrics, qos_waiting_ios, 1);
+        HISTOGRAM_OBSERVE(*next->metrics, qos_wait_latency_us, get_elapsed_time_us(iocb->op_start_time));
+        charge(*next, next_cls, iocb);
+        out.push_back(iocb);
+    }
+}
+
+void DriveQoS::dispatch(std::vector< drive_iocb* >& iocbs) {
+    for (auto iocb : iocbs) {
+        LOGDEBUGMOD(iomgr, "iocb admitted by qos: {}", iocb->to_string());
+        iocb->iface->submit_qos_admitted(iocb);
+    }
+}
+
+void DriveQoS::update_refill_timer() {
+    // Without rate limits, held back ios are admitted only by the completions which freed up the depth
+    const bool rate_limited = !m_stopped && ((m_params.iops_limit != 0) || (m_params.bw_limit != 0));
+    if (rate_limited && (m_refill_timer == null_timer_handle)) {
+        // Refill of a device needs one reactor only, the one setting the QoS if it is a reactor itself. Timer holds
+        // the QoS weakly, so that it can be cancelled without waiting from any thread.
+        auto schedule = [this, wp = weak_from_this()]() {
+            m_refill_timer = iomanager.schedule_thread_timer(
+                IM_DYNAMIC_CONFIG(drive.qos_refill_interval_us) * 1000ul, true, nullptr, [wp](void* cookie) {
+                    if (auto qos = wp.lock()) { qos->pump(); }
+                });
+        };
+        if (iomanager.am_i_io_reactor()) {
+            schedule();
+        } else {
+            iomanager.run_on_wait(reactor_regex::random_worker, schedule);
+        }
+    } else if (!rate_limited && (m_refill_timer != null_timer_handle)) {
+        iomanager.cancel_timer(m_refill_timer, false);
+        m_refill_timer = null_timer_handle;
+    }
+}
+} // namespace iomgr
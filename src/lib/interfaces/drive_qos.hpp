@@ -0,0 +1,106 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sisl/metrics/metrics.hpp>
+#include <iomgr/drive_interface.hpp>
+#include <iomgr/iomgr_timer.hpp>
+
+namespace iomgr {
+class DriveQoSMetrics : public sisl::MetricsGroup {
+public:
+    explicit DriveQoSMetrics(const std::string& inst_name) : sisl::MetricsGroup("DriveQoS", inst_name) {
+        REGISTER_COUNTER(qos_ios, "Number of ios admitted to the device by QoS");
+        REGISTER_COUNTER(qos_queued_ios, "Number of ios which were held back by QoS before admission");
+        REGISTER_COUNTER(qos_waiting_ios, "Ios held back by QoS", sisl::_publish_as::publish_as_gauge);
+        REGISTER_COUNTER(qos_outstanding_ios, "Ios admitted by QoS and outstanding on the device",
+                         sisl::_publish_as::publish_as_gauge);
+        REGISTER_HISTOGRAM(qos_wait_latency_us, "Time ios were held back by QoS");
+        register_me_to_farm();
+    }
+
+    ~DriveQoSMetrics() { deregister_me_from_farm(); }
+};
+
+// QoS of a device. Rate limits are token buckets of iops and bytes shared by all classes of the device, refilled
+// continuously and capped at a small burst. An io is admitted as long as tokens are positive, so an io larger than
+// the burst is not held back forever and the bucket just goes into debt. When ios are held back, classes are served
+// in the order of their virtual time which advances by the io size divided by the class weight, so the backlogged
+// classes share the device in the ratio of their weights. Held back ios are admitted as the ios of the device
+// complete and, while tokens are refilled, by a timer on a single reactor.
+class DriveQoS : public std::enable_shared_from_this< DriveQoS > {
+public:
+    explicit DriveQoS(IODevice* iodev);
+    ~DriveQoS();
+    DriveQoS(const DriveQoS&) = delete;
+    DriveQoS& operator=(const DriveQoS&) = delete;
+
+    void set_params(const drive_qos_params& params);
+    // Called when the device is closed. Cancels the refill timer and issues the held back ios right away, ios
+    // submitted afterwards are not subjected to QoS.
+    void stop();
+
+    // Returns true if io can be issued right away, else it is queued and submitted through its interface once
+    // admitted
+    bool admit(drive_iocb* iocb);
+    void on_complete(drive_iocb* iocb);
+
+private:
+    struct class_state {
+        std::deque< drive_iocb* > waitq;
+        uint32_t outstanding{0};
+        uint64_t vtime{0};
+        std::unique_ptr< DriveQoSMetrics > metrics;
+    };
+
+    struct token_bucket {
+        uint64_t rate{0}; // Tokens per second, 0 means unlimited
+        double tokens{0};
+
+        bool available() const { return (rate == 0) || (tokens > 0); }
+        void consume(uint64_t count) {
+            if (rate != 0) { tokens -= count; }
+        }
+        void refill(uint64_t elapsed_ns, uint64_t burst_us);
+    };
+
+    bool can_admit(const class_state& c, uint32_t cls) const;
+    void charge(class_state& c, uint32_t cls, drive_iocb* iocb);
+    void refill();
+    void collect_admitted(std::vector< drive_iocb* >& out);
+    void pump();
+    void dispatch(std::vector< drive_iocb* >& iocbs);
+    void update_refill_timer();
+
+private:
+    IODevice* m_iodev;
+    std::mutex m_mtx;
+    drive_qos_params m_params;
+    std::array< class_state, num_io_classes > m_classes;
+    token_bucket m_iops_bucket;
+    token_bucket m_bw_bucket;
+    Clock::time_point m_last_refill;
+    uint64_t m_vtime_floor{0}; // Virtual time of the last admitted io, idle classes start from here
+    uint32_t m_waiting{0};
+    bool m_stopped{false};
+    timer_handle_t m_refill_timer{null_timer_handle};
+};
+} // namespace iomgr
@@ -0,0 +1,144 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#include <algorithm>
+#include <cstdlib>
+#include <mutex>
+
+#include <sisl/fds/utils.hpp>
+#include "interfaces/iocb_slab.hpp"
+
+namespace iomgr {
+static constexpr uint32_t slab_block_size{64 * 1024};
+
+struct thread_slab_caches {
+    std::vector< SlabCache* > caches;
+    ~thread_slab_caches();
+};
+
+// Caches are never destroyed, since chunks could be freed to them after their owner thread exits
+struct slab_registry {
+    std::mutex mtx;
+    std::vector< SlabCache* > parked;
+};
+
+static slab_registry& registry() {
+    static slab_registry* s_registry = new slab_registry();
+    return *s_registry;
+}
+
+static thread_local thread_slab_caches t_slab_caches;
+
+thread_slab_caches::~thread_slab_caches() {
+    auto& reg = registry();
+    std::unique_lock lg{reg.mtx};
+    for (auto* cache : caches) {
+        cache->adopt(nullptr);
+        reg.parked.push_back(cache);
+    }
+    caches.clear();
+}
+
+SlabCache::SlabCache(uint32_t size, uint32_t max_cached) : m_chunk_size{size}, m_max_cached{max_cached} {}
+
+SlabCache::~SlabCache() {
+    for (auto* blk : m_blocks) {
+        std::free(blk);
+    }
+}
+
+SlabCache* SlabCache::thread_cache(uint32_t size, uint32_t max_cached) {
+    for (auto* cache : t_slab_caches.caches) {
+        if (cache->m_chunk_size == size) { return cache; }
+    }
+
+    SlabCache* cache{nullptr};
+    {
+        auto& reg = registry();
+        std::unique_lock lg{reg.mtx};
+        const auto it = std::find_if(reg.parked.begin(), reg.parked.end(),
+                                     [size](const SlabCache* c) { return c->m_chunk_size == size; });
+        if (it != reg.parked.end()) {
+            cache = *it;
+            reg.parked.erase(it);
+        } else {
+            cache = new SlabCache(size, max_cached);
+        }
+        cache->adopt(&t_slab_caches);
+    }
+    t_slab_caches.caches.push_back(cache);
+    return cache;
+}
+
+void* SlabCache::alloc(uint32_t size, uint32_t max_cached) { return thread_cache(size, max_cached)->alloc_chunk(); }
+
+void SlabCache::free(void* ptr) {
+    if (ptr == nullptr) { return; }
+    auto hdr = r_cast< chunk_hdr* >(ptr) - 1;
+    if (hdr->owner == nullptr) {
+        std::free(hdr);
+    } else {
+        hdr->owner->free_chunk(hdr);
+    }
+}
+
+void* SlabCache::alloc_chunk() {
+    if ((m_free_head == nullptr) && !refill()) {
+        // Cache is exhausted, serve it from heap
+        auto hdr = r_cast< chunk_hdr* >(std::malloc(sizeof(chunk_hdr) + m_chunk_size));
+        if (hdr == nullptr) { throw std::bad_alloc(); }
+        hdr->owner = nullptr;
+        return (void*)(hdr + 1);
+    }
+
+    auto hdr = m_free_head;
+    m_free_head = hdr->next;
+    return (void*)(hdr + 1);
+}
+
+void SlabCache::free_chunk(chunk_hdr* hdr) {
+    if (is_owned_by(&t_slab_caches)) {
+        hdr->next = m_free_head;
+        m_free_head = hdr;
+    } else {
+        hdr->next = m_remote_head.load(std::memory_order_relaxed);
+        while (!m_remote_head.compare_exchange_weak(hdr->next, hdr, std::memory_order_release,
+                                                    std::memory_order_relaxed)) {}
+    }
+}
+
+bool SlabCache::refill() {
+    // Reclaim all the chunks freed by other threads in one shot
+    m_free_head = m_remote_head.exchange(nullptr, std::memory_order_acquire);
+    if (m_free_head != nullptr) { return true; }
+    if (m_carved >= m_max_cached) { return false; }
+
+    const uint64_t stride =
+        sizeof(chunk_hdr) + ((m_chunk_size + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1));
+    const uint32_t count = std::min(m_max_cached - m_carved, std::max(1u, uint32_t(slab_block_size / stride)));
+    auto blk = r_cast< uint8_t* >(std::malloc(stride * count));
+    if (blk == nullptr) { return false; }
+    m_blocks.push_back(blk);
+    m_carved += count;
+
+    for (uint32_t i{0}; i < count; ++i) {
+        auto hdr = r_cast< chunk_hdr* >(blk + (i * stride));
+        hdr->owner = this;
+        hdr->next = m_free_head;
+        m_free_head = hdr;
+    }
+    return true;
+}
+
+void SlabCache::adopt(const void* owner) { m_owner.store(owner, std::memory_order_relaxed); }
+} // namespace iomgr
@@ -0,0 +1,87 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace iomgr {
+// Cache of equal sized memory chunks owned by a thread. Chunks are carved out of larger blocks and are never returned
+// to the system. A chunk freed on the owner thread goes back to its free list without any synchronization, chunk
+// freed on any other thread is pushed to the lock free remote free list of the owner, which the owner reclaims when
+// its own free list runs out. Once the owner thread exits, cache is parked and adopted by the next thread needing
+// the same size, so chunks freed after the owner exit are not lost.
+class SlabCache {
+public:
+    // Allocates a chunk of size from the cache of this thread. Once max_cached chunks are outstanding on this cache,
+    // chunks are allocated from the heap.
+    static void* alloc(uint32_t size, uint32_t max_cached);
+    static void free(void* ptr);
+
+    SlabCache(uint32_t size, uint32_t max_cached);
+    ~SlabCache();
+    SlabCache(const SlabCache&) = delete;
+    SlabCache& operator=(const SlabCache&) = delete;
+
+    uint32_t chunk_size() const { return m_chunk_size; }
+
+private:
+    struct chunk_hdr {
+        SlabCache* owner; // nullptr if the chunk is allocated from heap
+        chunk_hdr* next;
+    };
+    static_assert(sizeof(chunk_hdr) % alignof(std::max_align_t) == 0, "Chunk header must preserve the alignment");
+
+    void* alloc_chunk();
+    void free_chunk(chunk_hdr* hdr);
+    bool refill();
+    void adopt(const void* owner);
+    bool is_owned_by(const void* owner) const { return m_owner.load(std::memory_order_relaxed) == owner; }
+
+    static SlabCache* thread_cache(uint32_t size, uint32_t max_cached);
+
+private:
+    const uint32_t m_chunk_size;
+    const uint32_t m_max_cached;
+    std::atomic< const void* > m_owner{nullptr};
+    chunk_hdr* m_free_head{nullptr};
+    std::atomic< chunk_hdr* > m_remote_head{nullptr};
+    uint32_t m_carved{0};
+    std::vector< uint8_t* > m_blocks;
+
+    friend struct thread_slab_caches;
+};
+
+template < typename T, typename... Args >
+T* slab_new(uint32_t max_cached, Args&&... args) {
+    return new (SlabCache::alloc(sizeof(T), max_cached)) T(std::forward< Args >(args)...);
+}
+
+template < typename T >
+void slab_delete(T* obj) {
+    void* mem;
+    if constexpr (std::is_polymorphic_v< T >) {
+        mem = dynamic_cast< void* >(obj); // Start of the most derived object, which is what was allocated
+    } else {
+        mem = (void*)obj;
+    }
+    obj->~T();
+    SlabCache::free(mem);
+}
+} // namespace iomgr
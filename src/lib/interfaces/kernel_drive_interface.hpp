@@ -15,7 +15,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <sys/uio.h>
 
+#include <folly/executors/CPUThreadPoolExecutor.h>
 #include <iomgr/drive_interface.hpp>
 #include <iomgr/iomgr_types.hpp>
 #include "reactor/reactor.hpp"
@@ -35,8 +38,20 @@ public:
                                        uint64_t offset) override;
     virtual std::error_code sync_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) override;
 
+    // Max size of a single unmap/write zero issued to the device, larger ranges are split into these sizes
+    uint64_t max_zero_range_size(const IODevice* iodev) const;
+    // Max size of a single unmap issued to the device, which is the discard limit of the block device
+    uint64_t max_unmap_range_size(const IODevice* iodev) const;
+    static int fallocate_mode(const IODevice* iodev, DriveOpType op_type);
+
 protected:
     virtual void init_write_zero_buf(const std::string& devname, const drive_type dev_type);
+    uint32_t fill_zero_iovs(std::vector< iovec >& iovs, uint64_t size) const;
+
+    // Runs the blocking op, which kernel can't do asynchronously, in the offload threads and then calls the done_cb
+    // on the reactor which initiated the IO.
+    void offload_io(drive_iocb* iocb, std::function< int64_t(drive_iocb*) >&& blocking_op,
+                    std::function< void(drive_iocb*) >&& done_cb);
     virtual size_t get_dev_size(IODevice* iodev) override;
     virtual drive_attributes get_attributes(const std::string& devname, const drive_type drive_type) override;
 
@@ -47,5 +62,8 @@ private:
 private:
     std::unique_ptr< uint8_t, std::function< void(uint8_t* const) > > m_zero_buf{};
     uint64_t m_max_write_zeros{std::numeric_limits< uint64_t >::max()};
+    uint64_t m_max_discard{std::numeric_limits< uint64_t >::max()};
+    std::once_flag m_offload_init_flag;
+    std::unique_ptr< folly::CPUThreadPoolExecutor > m_offload_executor;
 };
 } // namespace iomgr
@@ -12,8 +12,13 @@
  * CONDITIONS OF ANY KIND, either express or implied. See the License for the
  * specific language governing permissions and limitations under the License.
  **************************************************************************/
+#include <condition_variable>
 #include <filesystem>
+#include <limits>
+#include <mutex>
 #include <thread>
+#include <vector>
+#include <sched.h>
 
 #include <sisl/fds/buffer.hpp>
 #include <sisl/fds/obj_allocator.hpp>
@@ -55,6 +60,7 @@ extern "C" {
 #include <iomgr/iomgr.hpp>
 #include "spdk/reactor_spdk.hpp"
 #include "interfaces/spdk_drive_interface.hpp"
+#include "interfaces/drive_io_merge.hpp"
 #include "watchdog.hpp"
 
 using namespace std::chrono_literals;
@@ -69,6 +75,13 @@ SpdkDriveInterface::SpdkDriveInterface(const io_interface_comp_cb_t& cb) : Drive
 
 static void bdev_event_cb(enum spdk_bdev_event_type type, spdk_bdev* bdev, void* event_ctx) {}
 
+static uint32_t this_numa_node() {
+    unsigned int cpu{0};
+    unsigned int node{0};
+    if (getcpu(&cpu, &node) != 0) { return 0; }
+    return node;
+}
+
 struct creat_ctx {
     std::string address;
     drive_type addr_type;
@@ -271,6 +284,12 @@ void SpdkDriveInterface::open_dev_internal(const io_device_ptr& iodev) {
     auto* bdev = spdk_bdev_get_by_name(iodev->alias_name.c_str());
     if (!bdev) { folly::throwSystemError(fmt::format("Unable to get opened device={}", iodev->alias_name)); }
     bdev->split_on_optimal_io_boundary = true;
+    if (!spdk_bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_FLUSH)) {
+        // Bdev modules don't support flush only when there is no volatile write cache to flush (e.g. nvme without
+        // VWC), so a completed write is already on stable media
+        LOGINFOMOD(iomgr, "Device {} bdev_name={} has no volatile write cache, durable writes complete without flush",
+                   iodev->devname, iodev->alias_name);
+    }
 
     add_io_device(iodev, true /* wait_to_add*/);
     LOGINFOMOD(iomgr, "Device {} bdev_name={} opened successfully", iodev->devname, iodev->alias_name);
@@ -282,6 +301,7 @@ void SpdkDriveInterface::close_dev(const io_device_ptr& iodev) {
 #endif
     // TODO: In the future might want to add atomic that will block any new read/write access to device that occur
     // after the close is called
+    DriveInterface::stop_qos(iodev.get());
 
     // check if current thread is reactor
     const auto& reactor = iomanager.this_reactor();
@@ -334,24 +354,65 @@ drive_type SpdkDriveInterface::detect_drive_type(const std::string& devname) {
     return drive_type::unknown;
 }
 
+// Sync io wakeups deferred to the end of the reactor loop, see wake_sync_io_waiters
+static thread_local bool t_defer_sync_wakeups{false};
+static thread_local poll_cb_idx_t t_sync_wakeup_cb_idx;
+static void wake_sync_io_waiters();
+
+// Channels created lazily on this reactor, which are reclaimed once idle
+static thread_local std::vector< SpdkDriveDeviceContext* > t_lazy_channels;
+static thread_local timer_handle_t t_channel_reclaim_timer{null_timer_handle};
+static void reclaim_idle_channels();
+
 void SpdkDriveInterface::init_iface_reactor_context(IOReactor* reactor) {
     if (reactor->is_tight_loop_reactor() && reactor->is_adaptive_loop()) {
         // Allow backoff only if there are no outstanding operations.
         reactor->add_backoff_cb([](IOReactor* reactor) -> bool { return (reactor->m_metrics->outstanding_ops == 0); });
     }
+    t_sync_wakeup_cb_idx = reactor->register_loop_end_cb(wake_sync_io_waiters);
+    t_defer_sync_wakeups = true;
+
+    const auto idle_sec = IM_DYNAMIC_CONFIG(drive.spdk_io_channel_idle_sec);
+    if (reactor->is_tight_loop_reactor() && IM_DYNAMIC_CONFIG(drive.spdk_lazy_io_channel) && (idle_sec != 0)) {
+        t_channel_reclaim_timer = iomanager.schedule_thread_timer(idle_sec * 1000ul * 1000ul * 1000ul, true, nullptr,
+                                                                  [](void*) { reclaim_idle_channels(); });
+    }
+
+    if (reactor->is_worker() && reactor->is_tight_loop_reactor()) {
+        std::unique_lock lg{m_route_mtx};
+        m_route_targets.push_back(route_target{reactor, this_numa_node()});
+    }
+}
+
+void SpdkDriveInterface::clear_iface_reactor_context(IOReactor* reactor) {
+    t_defer_sync_wakeups = false;
+    wake_sync_io_waiters();
+    reactor->unregister_loop_end_cb(t_sync_wakeup_cb_idx);
+    if (t_channel_reclaim_timer != null_timer_handle) {
+        iomanager.cancel_timer(t_channel_reclaim_timer, false);
+        t_channel_reclaim_timer = null_timer_handle;
+    }
+
+    std::unique_lock lg{m_route_mtx};
+    std::erase_if(m_route_targets, [reactor](const route_target& t) { return (t.reactor == reactor); });
 }
 
 void SpdkDriveInterface::init_iodev_reactor_context(const io_device_ptr& iodev, IOReactor* reactor) {
     if (!reactor->is_tight_loop_reactor()) { return; }
 
+    // With lazy channels, only the context is setup here and channel is created on first io of the fiber
+    const bool lazy = IM_DYNAMIC_CONFIG(drive.spdk_lazy_io_channel);
     auto orig_thread = spdk_get_thread();
     for (const auto& fiber : reactor->m_io_fibers) {
-        spdk_set_thread(fiber->spdk_thr);
         auto dctx = std::make_unique< SpdkDriveDeviceContext >();
-        dctx->channel = spdk_bdev_get_io_channel(iodev->bdev_desc());
-        if (dctx->channel == NULL) {
-            folly::throwSystemError(
-                fmt::format("Unable to get io channel for bdev={}", spdk_bdev_get_name(iodev->bdev())));
+        dctx->sthread = fiber->spdk_thr;
+        if (!lazy) {
+            spdk_set_thread(fiber->spdk_thr);
+            dctx->channel = spdk_bdev_get_io_channel(iodev->bdev_desc());
+            if (dctx->channel == NULL) {
+                folly::throwSystemError(
+                    fmt::format("Unable to get io channel for bdev={}", spdk_bdev_get_name(iodev->bdev())));
+            }
         }
         {
             // This step ensures that sparse vector of m_iodev_fiber_ctx if need be expands under lock.
@@ -367,24 +428,62 @@ void SpdkDriveInterface::clear_iodev_reactor_context(const io_device_ptr& iodev,
     if (!reactor->is_tight_loop_reactor()) { return; }
     auto orig_thread = spdk_get_thread();
     for (const auto& fiber : reactor->m_io_fibers) {
-        const auto* dctx = s_cast< SpdkDriveDeviceContext* >(iodev->m_iodev_fiber_ctx[fiber->ordinal].get());
+        auto* dctx = s_cast< SpdkDriveDeviceContext* >(iodev->m_iodev_fiber_ctx[fiber->ordinal].get());
         if (dctx && dctx->channel != NULL) {
             spdk_set_thread(fiber->spdk_thr);
             spdk_put_io_channel(dctx->channel);
         }
+        if (dctx) { std::erase(t_lazy_channels, dctx); }
         iodev->m_iodev_fiber_ctx[fiber->ordinal].reset();
     }
     spdk_set_thread(orig_thread);
 }
 
-static spdk_io_channel* get_io_channel(IODevice* iodev) {
+static void reclaim_idle_channels() {
+    // Channel is idle if no io was submitted on it since the last check and nothing is outstanding
+    auto orig_thread = spdk_get_thread();
+    std::erase_if(t_lazy_channels, [](SpdkDriveDeviceContext* dctx) {
+        if ((dctx->ios != 0) || (dctx->outstanding != 0)) {
+            dctx->ios = 0;
+            return false;
+        }
+        LOGDEBUGMOD(iomgr, "Releasing idle io channel={} of spdk thread={}", (void*)dctx->channel,
+                    spdk_thread_get_name(dctx->sthread));
+        spdk_set_thread(dctx->sthread);
+        spdk_put_io_channel(dctx->channel);
+        dctx->channel = nullptr;
+        return true;
+    });
+    spdk_set_thread(orig_thread);
+}
+
+// Returns the device context of a random fiber of this reactor, with its channel created if not already. Sets the
+// spdk thread of that fiber as current thread.
+static SpdkDriveDeviceContext* get_channel_ctx(IODevice* iodev) {
     auto reactor = iomanager.this_reactor();
     auto fiber = reactor->pick_fiber(fiber_regex::random);
-    const auto* dctx = s_cast< SpdkDriveDeviceContext* >(iodev->m_iodev_fiber_ctx[fiber->ordinal].get());
+    auto* dctx = s_cast< SpdkDriveDeviceContext* >(iodev->m_iodev_fiber_ctx[fiber->ordinal].get());
     RELEASE_ASSERT_NOTNULL((void*)dctx, "Null SpdkDriveDeviceContext for reactor={} for iodev={}",
                            reactor->reactor_idx(), iodev->devname);
     spdk_set_thread(fiber->spdk_thr);
-    return dctx->channel;
+    if (sisl_unlikely(dctx->channel == nullptr)) {
+        dctx->channel = spdk_bdev_get_io_channel(iodev->bdev_desc());
+        if (dctx->channel == nullptr) {
+            LOGERRORMOD(iomgr, "Unable to get io channel for bdev={} on reactor={}", spdk_bdev_get_name(iodev->bdev()),
+                        reactor->reactor_idx());
+            return nullptr;
+        }
+        t_lazy_channels.push_back(dctx);
+    }
+    ++dctx->ios;
+    return dctx;
+}
+
+static void put_channel_ctx(SpdkIocb* iocb) {
+    if (iocb->channel_ctx != nullptr) {
+        --iocb->channel_ctx->outstanding;
+        iocb->channel_ctx = nullptr;
+    }
 }
 
 static void submit_io(void* b);
@@ -423,33 +522,145 @@ static void complete_io(SpdkIocb* iocb, bool is_success) {
 
     if (sisl_likely(is_success)) {
         iocb->result = 0;
-        static std::error_code success;
-        std::visit(overloaded{[&](folly::Promise< std::error_code >& p) { p.setValue(success); },
-                              [&](FiberManagerLib::Promise< std::error_code >& p) { p.setValue(success); },
-                              [&](io_interface_comp_cb_t& cb) { cb(iocb->result); }},
-                   iocb->completion);
+        iocb->complete(std::error_code{});
     } else {
         COUNTER_INCREMENT(iocb->iface->get_metrics(), completion_errors, 1);
         if (resubmit_io_on_err(iocb)) { return; }
 
         iocb->result = -1;
-        static std::error_code io_error{EIO, std::generic_category()};
-        std::visit(overloaded{[&](folly::Promise< std::error_code >& p) { p.setValue(io_error); },
-                              [&](FiberManagerLib::Promise< std::error_code >& p) { p.setValue(io_error); },
-                              [&](io_interface_comp_cb_t& cb) { cb(iocb->result); }},
-                   iocb->completion);
+        iocb->complete(std::error_code{EIO, std::generic_category()});
+    }
+
+    // Child ios of a split io are not tracked by watchdog, only their parent is
+    if ((iocb->split_parent == nullptr) && iomanager.get_io_wd()->is_on()) { iomanager.get_io_wd()->complete_io(iocb); }
+    sisl::ObjectAllocator< SpdkIocb >::deallocate(iocb);
+}
+
+////////////////////////////// IO split section ///////////////////////////////
+static void complete_split_io(SpdkIocb* iocb) {
+    iocb->owns_by_spdk = false;
+    if (sisl_likely(!iocb->split_err)) {
+        iocb->result = 0;
+        iocb->complete(std::error_code{});
+    } else {
+        // Children are already resubmitted on error, so parent doesn't resubmit again
+        iocb->result = -1;
+        iocb->complete(iocb->split_err);
     }
 
     if (iomanager.get_io_wd()->is_on()) { iomanager.get_io_wd()->complete_io(iocb); }
     sisl::ObjectAllocator< SpdkIocb >::deallocate(iocb);
 }
 
+static void on_split_child_completion(std::error_code err, void* cookie) {
+    // All children are submitted and completed on the same spdk thread as the parent, no synchronization needed
+    auto parent = r_cast< SpdkIocb* >(cookie);
+    if (err && !parent->split_err) { parent->split_err = err; }
+    if (--parent->split_pending == 0) { complete_split_io(parent); }
+}
+
+// Splits the read/write into children, each within one optimal io boundary of the bdev and with its iovs within max
+// segment size and count. Each child except the last is a multiple of the write unit (block size for reads). Returns
+// empty if no split is needed or the iovs can't be split along these limits, in which case bdev layer splits it.
+static std::vector< SpdkIocb* > split_io(SpdkIocb* iocb) {
+    std::vector< SpdkIocb* > children;
+    if (!IM_DYNAMIC_CONFIG(drive.spdk_split_io) || (iocb->split_parent != nullptr) ||
+        ((iocb->op_type != DriveOpType::READ) && (iocb->op_type != DriveOpType::WRITE))) {
+        return children;
+    }
+
+    auto* bdev = iocb->iodev->bdev();
+    const uint64_t blk_size = spdk_bdev_get_block_size(bdev);
+    const uint64_t boundary = uint64_t(spdk_bdev_get_optimal_io_boundary(bdev)) * blk_size;
+    const uint64_t max_seg_size = (bdev->max_segment_size == 0) ? UINT64_MAX : bdev->max_segment_size;
+    const uint32_t max_segs = (bdev->max_num_segments == 0) ? UINT32_MAX : bdev->max_num_segments;
+    uint64_t unit = blk_size;
+    if (iocb->op_type == DriveOpType::WRITE) { unit *= std::max(spdk_bdev_get_write_unit_size(bdev), 1u); }
+
+    iovec data_iov;
+    const iovec* iovs{&data_iov};
+    uint32_t iovcnt{1};
+    if (iocb->has_iovs()) {
+        iovs = iocb->get_iovs();
+        iovcnt = s_cast< uint32_t >(iocb->iovcnt);
+    } else {
+        data_iov = iovec{iocb->get_data(), iocb->size};
+    }
+
+    bool need_split = (iovcnt > max_segs);
+    if ((boundary != 0) && ((iocb->offset / boundary) != ((iocb->offset + iocb->size - 1) / boundary))) {
+        need_split = true;
+    }
+    for (uint32_t i{0}; !need_split && (i < iovcnt); ++i) {
+        need_split = (iovs[i].iov_len > max_seg_size);
+    }
+    if (!need_split) { return children; }
+
+    std::vector< iovec > child_iovs;
+    uint32_t cur_iov{0};
+    uint64_t cur_iov_off{0};
+    uint64_t offset{iocb->offset};
+    uint64_t remaining{iocb->size};
+    while (remaining != 0) {
+        uint64_t limit{remaining};
+        if (boundary != 0) { limit = std::min(limit, boundary - (offset % boundary)); }
+
+        child_iovs.clear();
+        uint64_t len{0};
+        while ((len < limit) && (cur_iov < iovcnt) && (child_iovs.size() < max_segs)) {
+            const uint64_t take = std::min({iovs[cur_iov].iov_len - cur_iov_off, limit - len, max_seg_size});
+            child_iovs.push_back(iovec{r_cast< uint8_t* >(iovs[cur_iov].iov_base) + cur_iov_off, take});
+            len += take;
+            cur_iov_off += take;
+            if (cur_iov_off == iovs[cur_iov].iov_len) {
+                ++cur_iov;
+                cur_iov_off = 0;
+            }
+        }
+
+        // Trim the tail not making upto the unit, it goes to the next child
+        uint64_t trim = (len < remaining) ? (len % unit) : 0;
+        len -= trim;
+        while (trim != 0) {
+            auto& last = child_iovs.back();
+            const uint64_t cut = std::min(trim, uint64_t(last.iov_len));
+            if (cur_iov_off == 0) { cur_iov_off = iovs[--cur_iov].iov_len; }
+            cur_iov_off -= cut;
+            last.iov_len -= cut;
+            trim -= cut;
+            if (last.iov_len == 0) { child_iovs.pop_back(); }
+        }
+
+        if (len == 0) {
+            for (auto child : children) {
+                sisl::ObjectAllocator< SpdkIocb >::deallocate(child);
+            }
+            children.clear();
+            return children;
+        }
+
+        SpdkIocb* child =
+            sisl::ObjectAllocator< SpdkIocb >::make_object(iocb->iface, iocb->iodev, iocb->op_type, len, offset);
+        child->set_iovs(child_iovs.data(), s_cast< int >(child_iovs.size()));
+        child->io_wait_entry.cb_fn = submit_io;
+        child->durable = iocb->durable;
+        child->split_parent = iocb;
+        child->completion = drive_comp_cb{on_split_child_completion, (void*)iocb};
+        children.push_back(child);
+
+        offset += len;
+        remaining -= len;
+    }
+    return children;
+}
+
 static void process_completions(spdk_bdev_io* bdev_io, bool is_success, void* ctx) {
     SpdkIocb* iocb{static_cast< SpdkIocb* >(ctx)};
     DEBUG_ASSERT_NOTNULL((void*)iocb->iodev->bdev_desc());
 
     // LOGDEBUGMOD(iomgr, "Received completion on bdev = {}", (void*)iocb->iodev->bdev_desc());
     spdk_bdev_free_io(bdev_io);
+    put_channel_ctx(iocb);
 
 #ifdef _PRERELEASE
     const auto flip_resubmit_cnt{flip::Flip::instance().get_test_flip< uint32_t >("read_write_resubmit_io")};
@@ -457,6 +668,17 @@ static void process_completions(spdk_bdev_io* bdev_io, bool is_success, void* ct
 #endif
     if (sisl_likely(is_success)) {
         LOGDEBUGMOD(iomgr, "(bdev_io={}) iocb complete: mode=actual, {}", (void*)bdev_io, iocb->to_string());
+        if (iocb->durable && (iocb->op_type == DriveOpType::WRITE) &&
+            spdk_bdev_io_type_supported(iocb->iodev->bdev(), SPDK_BDEV_IO_TYPE_FLUSH)) {
+            // Write is done, now flush the range from the volatile cache of the device, on the same thread. Resubmit
+            // on flush error would then retry only the flush. Bdev without flush support has no volatile cache (logged
+            // on open), so its write is durable once completed.
+            DriveInterface::decrement_outstanding_counter(iocb);
+            iocb->op_type = DriveOpType::FSYNC;
+            iocb->owns_by_spdk = false;
+            submit_io(iocb);
+            return;
+        }
     } else {
         LOGERRORMOD(iomgr, "(bdev_io={}) iocb failed with status [{}]: mode=actual, {}", (void*)bdev_io,
                     explain_bdev_io_status(bdev_io), iocb->to_string());
@@ -472,57 +694,146 @@ static void submit_io(void* b) {
     DEBUG_ASSERT((iocb->owns_by_spdk == false), "Duplicate submission of iocb while io pending: {}", iocb->to_string());
     iocb->owns_by_spdk = true;
 
+    if (auto children = split_io(iocb); !children.empty()) {
+        LOGDEBUGMOD(iomgr, "iocb submit: mode=split, children={}, {}", children.size(), iocb->to_string());
+        COUNTER_INCREMENT(iocb->iface->get_metrics(), split_ios, 1);
+        COUNTER_INCREMENT(iocb->iface->get_metrics(), split_child_ios, children.size());
+        iocb->split_err = std::error_code{};
+        iocb->split_pending = s_cast< uint32_t >(children.size());
+        for (auto child : children) {
+            submit_io(child);
+        }
+        return;
+    }
+
     iocb->op_submit_time = Clock::now();
     DriveInterface::increment_outstanding_counter(iocb);
 
-    auto orig_thread = spdk_get_thread(); // get_io_channel sets the thread, use this to restore back
+    auto orig_thread = spdk_get_thread(); // get_channel_ctx sets the thread, use this to restore back
+
+    // Channel this io waited on for memory, if any, is no longer used by it
+    put_channel_ctx(iocb);
+    auto dctx = get_channel_ctx(iocb->iodev);
+    if (sisl_unlikely(dctx == nullptr)) {
+        spdk_set_thread(orig_thread);
+        complete_io(iocb, false /* is_success */);
+        return;
+    }
+    auto ch = dctx->channel;
+    iocb->channel_ctx = dctx;
+    ++dctx->outstanding;
 
     LOGDEBUGMOD(iomgr, "iocb submit: mode=actual, {}", iocb->to_string());
     if (iocb->op_type == DriveOpType::READ) {
         if (iocb->has_iovs()) {
-            rc = spdk_bdev_readv(iocb->iodev->bdev_desc(), get_io_channel(iocb->iodev), iocb->get_iovs(), iocb->iovcnt,
-                                 iocb->offset, iocb->size, process_completions, (void*)iocb);
+            rc = spdk_bdev_readv(iocb->iodev->bdev_desc(), ch, iocb->get_iovs(), iocb->iovcnt, iocb->offset,
+                                 iocb->size, process_completions, (void*)iocb);
         } else {
-            rc = spdk_bdev_read(iocb->iodev->bdev_desc(), get_io_channel(iocb->iodev), iocb->get_data(), iocb->offset,
-                                iocb->size, process_completions, (void*)iocb);
+            rc = spdk_bdev_read(iocb->iodev->bdev_desc(), ch, iocb->get_data(), iocb->offset, iocb->size,
+                                process_completions, (void*)iocb);
         }
     } else if (iocb->op_type == DriveOpType::WRITE) {
         if (iocb->has_iovs()) {
-            rc = spdk_bdev_writev(iocb->iodev->bdev_desc(), get_io_channel(iocb->iodev), iocb->get_iovs(), iocb->iovcnt,
-                                  iocb->offset, iocb->size, process_completions, (void*)iocb);
+            rc = spdk_bdev_writev(iocb->iodev->bdev_desc(), ch, iocb->get_iovs(), iocb->iovcnt, iocb->offset,
+                                  iocb->size, process_completions, (void*)iocb);
         } else {
-            rc = spdk_bdev_write(iocb->iodev->bdev_desc(), get_io_channel(iocb->iodev), iocb->get_data(), iocb->offset,
-                                 iocb->size, process_completions, (void*)iocb);
+            rc = spdk_bdev_write(iocb->iodev->bdev_desc(), ch, iocb->get_data(), iocb->offset, iocb->size,
+                                 process_completions, (void*)iocb);
         }
     } else if (iocb->op_type == DriveOpType::UNMAP) {
-        rc = spdk_bdev_unmap(iocb->iodev->bdev_desc(), get_io_channel(iocb->iodev), iocb->offset, iocb->size,
-                             process_completions, (void*)iocb);
+        rc = spdk_bdev_unmap(iocb->iodev->bdev_desc(), ch, iocb->offset, iocb->size, process_completions,
+                             (void*)iocb);
     } else if (iocb->op_type == DriveOpType::WRITE_ZERO) {
-        rc = spdk_bdev_write_zeroes(iocb->iodev->bdev_desc(), get_io_channel(iocb->iodev), iocb->offset, iocb->size,
-                                    process_completions, (void*)iocb);
+        rc = spdk_bdev_write_zeroes(iocb->iodev->bdev_desc(), ch, iocb->offset, iocb->size, process_completions,
+                                    (void*)iocb);
+    } else if (iocb->op_type == DriveOpType::FSYNC) {
+        rc = spdk_bdev_flush(iocb->iodev->bdev_desc(), ch, iocb->offset, iocb->size, process_completions,
+                             (void*)iocb);
     } else {
         rc = -EOPNOTSUPP;
         LOGDFATAL("Invalid operation type {}", iocb->op_type);
     }
-    spdk_set_thread(orig_thread);
 
     if (sisl_unlikely(rc != 0)) {
         // adjust count since unsuccessful command
         if (rc == -ENOMEM) {
+            // Wait on the same channel, which stays in use by this io until it is resubmitted
             DriveInterface::decrement_outstanding_counter(iocb);
             LOGDEBUGMOD(iomgr, "Bdev is lacking memory to do IO right away, queueing iocb: {}", iocb->to_string());
             COUNTER_INCREMENT(iocb->iface->get_metrics(), queued_ios_for_memory_pressure, 1);
-            spdk_bdev_queue_io_wait(iocb->iodev->bdev(), get_io_channel(iocb->iodev), &iocb->io_wait_entry);
+            spdk_bdev_queue_io_wait(iocb->iodev->bdev(), ch, &iocb->io_wait_entry);
             iocb->owns_by_spdk = false;
+            spdk_set_thread(orig_thread);
         } else {
+            spdk_set_thread(orig_thread);
             LOGERRORMOD(iomgr, "iocb {} submission failed with rc={}", iocb->to_string(), rc);
+            put_channel_ctx(iocb);
             complete_io(iocb, false /* is_success */);
         }
+    } else {
+        spdk_set_thread(orig_thread);
     }
 }
 
 static thread_local SpdkBatchIocb* s_batch_info_ptr = nullptr;
 
+static uint64_t route_hash(uint64_t key) {
+    // Fibonacci hashing, so that nearby device addresses and stripes are spread across reactors
+    return (key * 0x9E3779B97F4A7C15ull) >> 32;
+}
+
+io_fiber_t SpdkDriveInterface::route_io(const SpdkIocb* iocb) {
+    const auto routing = IM_DYNAMIC_CONFIG(drive.spdk_routing);
+    if (routing == iomgrcfg::SpdkRouting::LeastBusy) { return nullptr; }
+
+    std::shared_lock lg{m_route_mtx};
+    if (m_route_targets.empty()) { return nullptr; }
+
+    const uint64_t dev_key = r_cast< uint64_t >(iocb->iodev) >> 4;
+    IOReactor* target{nullptr};
+    switch (routing) {
+    case iomgrcfg::SpdkRouting::DeviceAffine:
+        target = m_route_targets[route_hash(dev_key) % m_route_targets.size()].reactor;
+        break;
+
+    case iomgrcfg::SpdkRouting::OffsetHash: {
+        const uint64_t stripe = iocb->offset / std::max(IM_DYNAMIC_CONFIG(drive.spdk_routing_stripe_size), 1ul);
+        target = m_route_targets[route_hash(dev_key ^ stripe) % m_route_targets.size()].reactor;
+        break;
+    }
+
+    case iomgrcfg::SpdkRouting::NumaLocal: {
+        // Least busy reactor on submitter's node, else least busy anywhere
+        const uint32_t node = this_numa_node();
+        uint64_t min_ops{std::numeric_limits< uint64_t >::max()};
+        bool local{false};
+        for (const auto& t : m_route_targets) {
+            const bool is_local = (t.numa_node == node);
+            if (local && !is_local) { continue; }
+            const uint64_t ops = t.reactor->thread_metrics().outstanding_ops;
+            if ((is_local && !local) || (ops < min_ops)) {
+                min_ops = ops;
+                target = t.reactor;
+                local = is_local;
+            }
+        }
+        if (!local) { COUNTER_INCREMENT(m_metrics, routed_non_local_numa, 1); }
+        break;
+    }
+
+    default:
+        break;
+    }
+    return (target == nullptr) ? nullptr : target->main_fiber();
+}
+
+void SpdkDriveInterface::send_to_reactor(const SpdkIocb* iocb, const std::function< void(void) >& fn) {
+    auto fiber = route_io(iocb);
+    const auto sent_to = (fiber != nullptr) ? iomanager.run_on_forget(fiber, fn)
+                                            : iomanager.run_on_forget(reactor_regex::least_busy_worker, fn);
+    LOGMSG_ASSERT(sent_to != 0, "Unable to send the io to any spdk reactor");
+}
+
 static void update_batch_counter(size_t batch_size) {
     auto& thread_metrics = iomanager.this_thread_metrics();
     thread_metrics.iface_io_actual_count += batch_size;
@@ -530,6 +841,7 @@ static void update_batch_counter(size_t batch_size) {
 }
 
 void SpdkDriveInterface::submit_async_io(SpdkIocb* iocb, bool part_of_batch) {
+    if (!DriveInterface::qos_admit(iocb)) { return; }
     if (iomanager.am_i_tight_loop_reactor()) {
         LOGDEBUGMOD(iomgr, "iocb submit: mode=tloop, {}", iocb->to_string());
         update_batch_counter(1);
@@ -538,7 +850,7 @@ void SpdkDriveInterface::submit_async_io(SpdkIocb* iocb, bool part_of_batch) {
         LOGDEBUGMOD(iomgr, "iocb submit: mode=non_tloop, {}", iocb->to_string());
         COUNTER_INCREMENT(m_metrics, num_async_io_non_spdk_thread, 1);
         update_batch_counter(1);
-        iomanager.run_on_forget(reactor_regex::least_busy_worker, [iocb, this]() {
+        send_to_reactor(iocb, [iocb]() {
             LOGDEBUGMOD(iomgr, "iocb submit: mode=queue_io, {}", iocb->to_string());
             submit_io(iocb);
         });
@@ -557,18 +869,46 @@ void SpdkDriveInterface::submit_async_io(SpdkIocb* iocb, bool part_of_batch) {
     if (iomanager.get_io_wd()->is_on()) { IOManager::instance().get_io_wd()->add_io(iocb); }
 }
 
+void SpdkDriveInterface::submit_qos_admitted(drive_iocb* iocb) {
+    submit_async_io(static_cast< SpdkIocb* >(iocb), false /* part_of_batch */);
+}
+
+static void on_merged_io_completion(std::error_code err, void* cookie) {
+    auto merged = r_cast< SpdkIocb* >(cookie);
+    for_each_merged_member(merged, [merged, &err](drive_iocb* m) {
+        m->result = merged->result;
+        m->complete(err);
+        if (iomanager.get_io_wd()->is_on()) { iomanager.get_io_wd()->complete_io(m); }
+        sisl::ObjectAllocator< SpdkIocb >::deallocate(r_cast< SpdkIocb* >(m));
+    });
+}
+
 void SpdkDriveInterface::submit_batch() {
     // s_batch_info_ptr could be nullptr when client calls submit_batch
     if (s_batch_info_ptr) {
+        if (io_merge_enabled()) {
+            merge_batch_ios(*(s_batch_info_ptr->batch_io), [this](SpdkIocb* first, uint64_t size) {
+                auto merged = sisl::ObjectAllocator< SpdkIocb >::make_object(this, first->iodev, first->op_type, size,
+                                                                             first->offset);
+                merged->io_wait_entry.cb_fn = submit_io;
+                merged->batch_info_ptr = first->batch_info_ptr;
+                merged->completion = drive_comp_cb{on_merged_io_completion, (void*)merged};
+                if (iomanager.get_io_wd()->is_on()) { iomanager.get_io_wd()->add_io(merged); }
+                return merged;
+            });
+        }
         update_batch_counter(s_batch_info_ptr->batch_io->size());
 
-        auto const sent_to =
-            iomanager.run_on_forget(reactor_regex::least_busy_worker, [batch_info = s_batch_info_ptr]() {
-                for (auto& iocb : *(batch_info->batch_io)) {
-                    LOGDEBUGMOD(iomgr, "iocb submit: mode=queue_batch_io, {}", iocb->to_string());
-                    submit_io(iocb);
-                }
-            });
+        // Whole batch goes to one reactor, routed by its first io
+        auto batch_fn = [batch_info = s_batch_info_ptr]() {
+            for (auto& iocb : *(batch_info->batch_io)) {
+                LOGDEBUGMOD(iomgr, "iocb submit: mode=queue_batch_io, {}", iocb->to_string());
+                submit_io(iocb);
+            }
+        };
+        auto fiber = route_io(s_batch_info_ptr->batch_io->front());
+        auto const sent_to = (fiber != nullptr) ? iomanager.run_on_forget(fiber, batch_fn)
+                                                : iomanager.run_on_forget(reactor_regex::least_busy_worker, batch_fn);
 
         if (sent_to == 0) {
             // if message is not delivered, release memory here;
@@ -582,13 +922,133 @@ void SpdkDriveInterface::submit_batch() {
     // it will be null operation if client calls this function without anything in s_batch_info_ptr
 }
 
+void SpdkDriveInterface::async_submit(std::span< const drive_io_request > reqs) {
+    // All requests go as one batch message to the spdk thread, unless this is the spdk thread itself
+    for (const auto& req : reqs) {
+        if (!req.is_valid() || (req.op_type == DriveOpType::FSYNC)) {
+            submit_request(req, false /* part_of_batch */);
+            continue;
+        }
+
+        SpdkIocb* iocb =
+            sisl::ObjectAllocator< SpdkIocb >::make_object(this, req.iodev, req.op_type, req.size, req.offset);
+        if ((req.op_type == DriveOpType::READ) || (req.op_type == DriveOpType::WRITE)) {
+            if (req.data != nullptr) {
+                iocb->set_data(req.data);
+            } else {
+                iocb->set_iovs(req.iov, req.iovcnt);
+            }
+        }
+        iocb->io_wait_entry.cb_fn = submit_io;
+        iocb->completion = req.cb;
+        submit_async_io(iocb, true /* part_of_batch */);
+    }
+    submit_batch();
+}
+
+////////////////////////////// Sync IO completion section ///////////////////////////////
+// Completion slot of a thread doing sync io outside of the reactors, waiter sleeps on the state with futex. Slots are
+// never freed and a thread returns its slot on exit for the next thread, so a delayed wakeup from a reactor can only
+// cause a spurious wakeup of the slot's next owner, which the waiter ignores.
+struct sync_io_slot {
+    static constexpr uint32_t idle{0};
+    static constexpr uint32_t sleeping{1};
+    static constexpr uint32_t done{2};
+    static constexpr uint32_t spin_count{256};
+
+    std::atomic< uint32_t > state{idle};
+    std::error_code err;
+
+    std::error_code wait() {
+        for (uint32_t i{0}; i < spin_count; ++i) {
+            if (state.load(std::memory_order_acquire) == done) { return err; }
+        }
+
+        uint32_t expected{idle};
+        if (state.compare_exchange_strong(expected, sleeping, std::memory_order_acq_rel)) {
+            while (state.load(std::memory_order_acquire) != done) {
+                state.wait(sleeping, std::memory_order_acquire);
+            }
+        }
+        return err;
+    }
+};
+
+struct sync_io_slot_owner {
+    sync_io_slot* slot;
+    sync_io_slot_owner();
+    ~sync_io_slot_owner();
+};
+
+struct sync_io_slot_registry {
+    std::mutex mtx;
+    std::vector< sync_io_slot* > free_slots;
+};
+
+static sync_io_slot_registry& slot_registry() {
+    static sync_io_slot_registry* s_registry = new sync_io_slot_registry();
+    return *s_registry;
+}
+
+sync_io_slot_owner::sync_io_slot_owner() {
+    auto& reg = slot_registry();
+    std::unique_lock lg{reg.mtx};
+    if (reg.free_slots.empty()) {
+        slot = new sync_io_slot();
+    } else {
+        slot = reg.free_slots.back();
+        reg.free_slots.pop_back();
+    }
+}
+
+sync_io_slot_owner::~sync_io_slot_owner() {
+    auto& reg = slot_registry();
+    std::unique_lock lg{reg.mtx};
+    reg.free_slots.push_back(slot);
+}
+
+static thread_local sync_io_slot_owner t_sync_slot;
+
+// Reactor completing the sync ios defers the futex wakeups to the end of its loop, so that all the waiters completed
+// in one poll are woken together instead of a syscall inline with each completion.
+static thread_local std::vector< sync_io_slot* > t_pending_sync_wakeups;
+
+static void wake_sync_io_waiters() {
+    for (auto slot : t_pending_sync_wakeups) {
+        slot->state.notify_one();
+    }
+    t_pending_sync_wakeups.clear();
+}
+
+static void on_sync_io_completion(std::error_code err, void* cookie) {
+    auto slot = r_cast< sync_io_slot* >(cookie);
+    slot->err = err;
+    if (slot->state.exchange(sync_io_slot::done, std::memory_order_acq_rel) == sync_io_slot::sleeping) {
+        if (t_defer_sync_wakeups) {
+            t_pending_sync_wakeups.push_back(slot);
+        } else {
+            slot->state.notify_one();
+        }
+    }
+}
+
 std::error_code SpdkDriveInterface::submit_sync_io(SpdkIocb* iocb) {
     LOGDEBUGMOD(iomgr, "iocb submit: mode=sync, {}", iocb->to_string());
 
-    iocb->completion = std::move(FiberManagerLib::Promise< std::error_code >{});
-    auto f = iocb->fiber_comp_promise().getFuture();
+    if (iomanager.this_reactor() != nullptr) {
+        // Sync io capable fibers of reactor should yield to other fibers instead of blocking the reactor
+        iocb->completion = std::move(FiberManagerLib::Promise< std::error_code >{});
+        auto f = iocb->fiber_comp_promise().getFuture();
+        submit_async_io(iocb, false /* part_of_batch */);
+        return f.get();
+    }
+
+    COUNTER_INCREMENT(m_metrics, sync_io_non_reactor_thread, 1);
+    auto slot = t_sync_slot.slot;
+    slot->state.store(sync_io_slot::idle, std::memory_order_relaxed);
+    iocb->completion = drive_comp_cb{on_sync_io_completion, (void*)slot};
     submit_async_io(iocb, false /* part_of_batch */);
-    return f.get();
+    return slot->wait();
 }
 
 folly::Future< std::error_code > SpdkDriveInterface::async_write(IODevice* iodev, const char* data, uint32_t size,
@@ -603,6 +1063,68 @@ folly::Future< std::error_code > SpdkDriveInterface::async_write(IODevice* iodev
     return ret;
 }
 
+void SpdkDriveInterface::async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset,
+                                        const drive_comp_cb& cb, bool part_of_batch) {
+    SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_data(const_cast< char* >(data));
+    iocb->io_wait_entry.cb_fn = submit_io;
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
+
+void SpdkDriveInterface::async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
+                                         uint64_t offset, const drive_comp_cb& cb, bool part_of_batch) {
+    SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_iovs(iov, iovcnt);
+    iocb->io_wait_entry.cb_fn = submit_io;
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
+
+void SpdkDriveInterface::async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset,
+                                       const drive_comp_cb& cb, bool part_of_batch) {
+    SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::READ, size, offset);
+    iocb->set_data(data);
+    iocb->io_wait_entry.cb_fn = submit_io;
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
+
+void SpdkDriveInterface::async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
+                                        uint64_t offset, const drive_comp_cb& cb, bool part_of_batch) {
+    SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::READ, size, offset);
+    iocb->set_iovs(iov, iovcnt);
+    iocb->io_wait_entry.cb_fn = submit_io;
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
+
+folly::Future< std::error_code > SpdkDriveInterface::async_write_durable(IODevice* iodev, const char* data,
+                                                                         uint32_t size, uint64_t offset) {
+    SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_data(const_cast< char* >(data));
+    iocb->durable = true;
+    iocb->io_wait_entry.cb_fn = submit_io;
+    iocb->completion = std::move(folly::Promise< std::error_code >{});
+
+    auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, false /* part_of_batch */);
+    return ret;
+}
+
+folly::Future< std::error_code > SpdkDriveInterface::async_writev_durable(IODevice* iodev, const iovec* iov,
+                                                                          int iovcnt, uint32_t size, uint64_t offset) {
+    SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_iovs(iov, iovcnt);
+    iocb->durable = true;
+    iocb->io_wait_entry.cb_fn = submit_io;
+    iocb->completion = std::move(folly::Promise< std::error_code >{});
+
+    auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, false /* part_of_batch */);
+    return ret;
+}
+
 folly::Future< std::error_code > SpdkDriveInterface::async_read(IODevice* iodev, char* data, uint32_t size,
                                                                 uint64_t offset, bool part_of_batch) {
     SpdkIocb* iocb = sisl::ObjectAllocator< SpdkIocb >::make_object(this, iodev, DriveOpType::READ, size, offset);
@@ -17,12 +17,12 @@
 #include <array>
 #include <atomic>
 #include <chrono>
-#include <condition_variable>
 #include <cstdint>
 #include <cstring>
 #include <memory>
 #include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <variant>
@@ -45,9 +45,13 @@ struct spdk_io_channel;
 struct spdk_thread;
 
 namespace iomgr {
+// Accessed only from the reactor owning the fiber
 struct SpdkDriveDeviceContext : public IODeviceThreadContext {
     ~SpdkDriveDeviceContext() = default;
-    spdk_io_channel* channel{nullptr};
+    spdk_io_channel* channel{nullptr}; // nullptr until first io on the fiber if channels are lazy, or once reclaimed
+    spdk_thread* sthread{nullptr};
+    uint32_t outstanding{0}; // IOs holding the channel, including those waiting on it for memory
+    uint64_t ios{0};         // IOs submitted since the last idle check
 };
 
 class SpdkDriveInterfaceMetrics : public DriveInterfaceMetrics {
@@ -57,6 +61,10 @@ public:
         REGISTER_COUNTER(num_async_io_non_spdk_thread, "Count of async ios issued from non-spdk threads");
         REGISTER_COUNTER(force_sync_io_non_spdk_thread,
                          "Count of async ios converted to sync ios because of non-spdk threads");
+        REGISTER_COUNTER(split_ios, "Count of ios split by iomgr as per the bdev io boundary and segment limits");
+        REGISTER_COUNTER(split_child_ios, "Count of child ios issued for the split ios");
+        REGISTER_COUNTER(routed_non_local_numa, "Count of ios routed to reactor of other NUMA node than submitter");
+        REGISTER_COUNTER(sync_io_non_reactor_thread, "Count of sync ios issued from threads outside of reactors");
         REGISTER_COUNTER(queued_ios_for_memory_pressure, "Count of times drive queued ios because of lack of memory");
 
         register_me_to_farm();
@@ -92,6 +100,14 @@ public:
                                                 bool part_of_batch = false) override;
     folly::Future< std::error_code > async_readv(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
                                                  uint64_t offset, bool part_of_batch = false) override;
+    void async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                        bool part_of_batch = false) override;
+    void async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                         const drive_comp_cb& cb, bool part_of_batch = false) override;
+    void async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                       bool part_of_batch = false) override;
+    void async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                        const drive_comp_cb& cb, bool part_of_batch = false) override;
     folly::Future< std::error_code > async_unmap(IODevice* iodev, uint32_t size, uint64_t offset,
                                                  bool part_of_batch = false) override;
     folly::Future< std::error_code > async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) override;
@@ -106,6 +122,11 @@ public:
         LOGWARN("fsync on spdk drive interface is not supported");
         return folly::makeFuture< std::error_code >(std::error_code(ENOTSUP, std::system_category()));
     }
+    folly::Future< std::error_code > async_write_durable(IODevice* iodev, const char* data, uint32_t size,
+                                                         uint64_t offset) override;
+    folly::Future< std::error_code > async_writev_durable(IODevice* iodev, const iovec* iov, int iovcnt,
+                                                          uint32_t size, uint64_t offset) override;
+    void async_submit(std::span< const drive_io_request > reqs) override;
     void submit_batch() override;
 
     io_interface_comp_cb_t& get_completion_cb() { return m_comp_cb; }
@@ -122,21 +143,30 @@ private:
     io_device_ptr create_open_dev_internal(const std::string& devname, drive_type drive_type);
     void open_dev_internal(const io_device_ptr& iodev);
     void init_iface_reactor_context(IOReactor*) override;
-    void clear_iface_reactor_context(IOReactor*) override {}
+    void clear_iface_reactor_context(IOReactor* reactor) override;
 
     void init_iodev_reactor_context(const io_device_ptr& iodev, IOReactor* reactor) override;
     void clear_iodev_reactor_context(const io_device_ptr& iodev, IOReactor* reactor) override;
 
     void submit_async_io(SpdkIocb* iocb, bool part_of_batch);
+    void submit_qos_admitted(drive_iocb* iocb) override;
     std::error_code submit_sync_io(SpdkIocb* iocb);
+    // Picks the reactor for io from a non-spdk thread as per routing config, nullptr means any least busy worker
+    io_fiber_t route_io(const SpdkIocb* iocb);
+    void send_to_reactor(const SpdkIocb* iocb, const std::function< void(void) >& fn);
 
 private:
-    std::mutex m_sync_cv_mutex;
-    std::condition_variable m_sync_cv;
+    struct route_target {
+        IOReactor* reactor;
+        uint32_t numa_node;
+    };
+
     SpdkDriveInterfaceMetrics m_metrics;
     std::mutex m_opened_dev_mtx;
     std::unordered_map< std::string, io_device_ptr > m_opened_device;
     std::atomic< size_t > m_outstanding_async_ios;
+    std::shared_mutex m_route_mtx;
+    std::vector< route_target > m_route_targets; // Worker spdk reactors
 };
 
 struct SpdkBatchIocb {
@@ -159,6 +189,10 @@ struct SpdkIocb : public drive_iocb {
     spdk_bdev_io_wait_entry io_wait_entry;
     SpdkBatchIocb* batch_info_ptr{nullptr};
     bool owns_by_spdk{false};
+    SpdkIocb* split_parent{nullptr}; // Set on the child ios of an io split as per the bdev limits
+    uint32_t split_pending{0};       // Children of this io yet to complete
+    std::error_code split_err;       // First error among the children of this io
+    SpdkDriveDeviceContext* channel_ctx{nullptr}; // Channel this io is submitted to or waiting on
 
     SpdkIocb(DriveInterface* iface, IODevice* iodev, DriveOpType op_type, uint64_t size, uint64_t offset) :
             drive_iocb{iface, iodev, op_type, size, offset} {
@@ -31,16 +31,95 @@
 #include <linux/version.h>
 #endif
 
+#include <cstring>
 #include <sisl/fds/utils.hpp>
 #include <sisl/logging/logging.h>
 #include "epoll/reactor_epoll.hpp"
+#include "interfaces/iocb_slab.hpp"
+#include "interfaces/drive_io_merge.hpp"
 
 namespace iomgr {
 thread_local uring_drive_channel* UringDriveInterface::t_uring_ch{nullptr};
+thread_local uring_drive_channel* UringDriveInterface::t_iopoll_ch{nullptr};
 
-uring_drive_channel::uring_drive_channel(UringDriveInterface* iface) {
-    int ret = io_uring_queue_init(UringDriveInterface::per_thread_qdepth, &m_ring, 0);
-    if (ret) { folly::throwSystemError(fmt::format("Unable to create uring queue created ret={}", ret)); }
+// Batched reads/writes of this reactor held till submit_batch, so that the contiguous ones are merged
+static thread_local std::vector< drive_iocb* > t_merge_q;
+
+static drive_iocb* alloc_iocb(DriveInterface* iface, IODevice* iodev, DriveOpType op_type, uint64_t size,
+                              uint64_t offset) {
+    return slab_new< drive_iocb >(IM_DYNAMIC_CONFIG(drive.iocb_cache_count), iface, iodev, op_type, size, offset);
+}
+
+uring_drive_channel::uring_drive_channel(UringDriveInterface* iface, bool iopoll) : m_iface{iface}, m_iopoll{iopoll} {
+    const uint32_t sq_depth = IM_DYNAMIC_CONFIG(uring.sq_depth);
+    const uint32_t cq_depth = IM_DYNAMIC_CONFIG(uring.cq_depth);
+    auto set_ring_flags = [this, sq_depth, cq_depth](struct io_uring_params& params) {
+        if (m_iopoll) { params.flags |= IORING_SETUP_IOPOLL; }
+        if (cq_depth > sq_depth) {
+            params.flags |= IORING_SETUP_CQSIZE;
+            params.cq_entries = cq_depth;
+        }
+    };
+
+    struct io_uring_params params;
+    int ret{-1};
+    if (IM_DYNAMIC_CONFIG(uring.sqpoll)) {
+        // Attach to the shared kernel poller if there is one, else create a poller of our own
+        for (const bool attach : {true, false}) {
+            if (!iface->fill_sqpoll_params(params, attach)) { continue; }
+            set_ring_flags(params);
+            ret = io_uring_queue_init_params(sq_depth, &m_ring, &params);
+            if (ret == 0) { break; }
+        }
+
+        if (ret == 0) {
+            m_sqpoll = true;
+            iface->on_sqpoll_ring_created(m_ring.ring_fd);
+        } else {
+            LOGWARNMOD(iomgr, "Unable to create uring with sqpoll ret={}, falling back to regular submission", ret);
+        }
+    }
+
+    if (!m_sqpoll) {
+        std::memset(&params, 0, sizeof(params));
+        set_ring_flags(params);
+        ret = io_uring_queue_init_params(sq_depth, &m_ring, &params);
+        if (ret) { folly::throwSystemError(fmt::format("Unable to create uring queue created ret={}", ret)); }
+    }
+
+    // Kernel rounds up the sizes, use whatever it has setup. IOs in flight are limited to CQ size, so that CQ can't
+    // overflow.
+    m_cq_depth = params.cq_entries;
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        LOGINFOMOD(iomgr, "Kernel doesn't support IORING_FEAT_NODROP, CQ overflow will drop completions");
+    }
+
+    if (iface->fixed_bufs() != nullptr) {
+        const auto& iovs = iface->fixed_bufs()->registered_iovs();
+        ret = io_uring_register_buffers(&m_ring, iovs.data(), iovs.size());
+        if (ret) {
+            // Most likely RLIMIT_MEMLOCK is too low, IOs on this ring continue to work on regular buffers
+            LOGWARNMOD(iomgr, "Unable to register fixed buffers of count={} to uring, ret={}, not using them",
+                       iovs.size(), ret);
+        } else {
+            m_fixed_bufs = iface->fixed_bufs();
+        }
+    }
+
+    if (const auto nfiles = IM_DYNAMIC_CONFIG(uring.max_fixed_files); nfiles != 0) {
+        // Register a sparse table, devices are filled in on their first IO on this ring
+        std::vector< int > fds(nfiles, -1);
+        ret = io_uring_register_files(&m_ring, fds.data(), nfiles);
+        if (ret) {
+            LOGWARNMOD(iomgr, "Unable to register fixed file table of size={} to uring, ret={}, not using them", nfiles,
+                       ret);
+        } else {
+            m_fixed_files = std::move(fds);
+        }
+    }
+
+    // Polled ring doesn't generate any completion events, it is reaped by the sentinel of the regular ring
+    if (m_iopoll) { return; }
 
     int ev_fd = eventfd(0, EFD_NONBLOCK);
     if (ev_fd == -1) { folly::throwSystemError("Unable to create eventfd to listen for uring queue events"); }
@@ -54,9 +133,14 @@ uring_drive_channel::uring_drive_channel(UringDriveInterface* iface) {
         backing_dev_t(ev_fd), EPOLLIN, 0, nullptr, true,
         std::bind(&UringDriveInterface::on_event_notification, iface, _1, _2, _3));
     iomanager.this_reactor()->attach_iomgr_sentinel_cb([iface]() { iface->handle_completions(); });
+
+    if (const auto depth = IM_DYNAMIC_CONFIG(uring.submit_ring_depth); depth != 0) {
+        m_submit_q = std::make_unique< folly::MPMCQueue< drive_iocb* > >(depth);
+    }
 }
 
 uring_drive_channel::~uring_drive_channel() {
+    if (m_sqpoll) { m_iface->on_sqpoll_ring_destroyed(m_ring.ring_fd); }
     io_uring_queue_exit(&m_ring);
     if (m_ring_ev_iodev != nullptr) {
         iomanager.this_reactor()->detach_iomgr_sentinel_cb();
@@ -66,11 +150,12 @@ uring_drive_channel::~uring_drive_channel() {
 }
 
 struct io_uring_sqe* uring_drive_channel::get_sqe_or_enqueue(drive_iocb* iocb) {
-    if (!can_submit()) {
+    const auto nsqes = sqes_needed(iocb);
+    if (!can_submit(nsqes)) {
         m_iocb_waitq.push(iocb);
         return nullptr;
     }
-    struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+    struct io_uring_sqe* sqe = (io_uring_sq_space_left(&m_ring) >= nsqes) ? io_uring_get_sqe(&m_ring) : nullptr;
     if (!sqe) {
         // No available slots. Before enqueing we submit ios which were added as part of batch processing.
         submit_ios();
@@ -81,6 +166,19 @@ struct io_uring_sqe* uring_drive_channel::get_sqe_or_enqueue(drive_iocb* iocb) {
     return sqe;
 }
 
+bool uring_drive_channel::queue_from_remote(drive_iocb* iocb) {
+    if (!m_submit_q->write(iocb)) { return false; }
+
+    // Pairs with the fence in drain, either reactor finds this iocb while draining or we find the flag cleared and
+    // wake it up again
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!m_wakeup_pending.exchange(true)) {
+        const uint64_t one{1};
+        [[maybe_unused]] auto wsize = write(m_ring_ev_iodev->fd(), &one, sizeof(uint64_t));
+    }
+    return true;
+}
+
 void uring_drive_channel::submit_ios() {
     if (m_prepared_ios != 0) {
         const auto ret = io_uring_submit(&m_ring);
@@ -88,22 +186,86 @@ void uring_drive_channel::submit_ios() {
             DEBUG_ASSERT(false, "prepared ios must be always equal or greater than just-submitted ios");
         }
         DEBUG_ASSERT_GT(ret, 0, "Facing an error in io_uring_submit");
+        if (m_iopoll && (m_in_flight_ios == 0) && (ret > 0)) {
+            // Polled IOs don't wakeup the reactor, so run it in tight loop until they are completed
+            iomanager.this_reactor()->hold_tight_loop();
+        }
         m_in_flight_ios += ret;
 
         m_prepared_ios -= ret;
     }
 }
 
+void uring_drive_channel::dec_in_flight() {
+    --m_in_flight_ios;
+    if (m_iopoll && (m_in_flight_ios == 0)) { iomanager.this_reactor()->release_tight_loop(); }
+}
+
+void uring_drive_channel::check_overflow(UringDriveInterfaceMetrics& metrics) {
+    const uint32_t overflow = IO_URING_READ_ONCE(*m_ring.cq.koverflow);
+    if (sisl_unlikely(overflow != m_last_overflow)) {
+        // Ring is sized to have room for every IO in flight, so this is not expected. Kernels which don't support
+        // NODROP lose these completions and the IOs will never complete; report it and continue.
+        COUNTER_INCREMENT(metrics, overflow_errors, 1);
+        COUNTER_INCREMENT(metrics, num_of_drops, overflow - m_last_overflow);
+        LOGERRORMOD(iomgr, "CQ overflow - number of dropped io requests: {}, in_flight={} cq_depth={}",
+                    overflow - m_last_overflow, m_in_flight_ios, m_cq_depth);
+        m_last_overflow = overflow;
+    }
+}
+
+void uring_drive_channel::poll_device() {
+    if (m_in_flight_ios == 0) { return; }
+    if (m_sqpoll) {
+        // Kernel poller thread polls the device for us
+        return;
+    } else if (m_prepared_ios != 0) {
+        submit_ios();
+    } else {
+        // Submit on polled ring enters kernel with GETEVENTS, which polls the device for completions
+        io_uring_submit(&m_ring);
+    }
+}
+
 void uring_drive_channel::submit_if_needed(drive_iocb* iocb, struct io_uring_sqe* sqe, bool part_of_batch) {
     io_uring_sqe_set_data(sqe, (void*)iocb);
     ++m_prepared_ios;
+    if (iocb->durable) { prep_linked_flush(iocb, sqe); }
     if (!part_of_batch) { submit_ios(); }
 }
 
-static void prep_sqe_from_iocb(drive_iocb* iocb, struct io_uring_sqe* sqe) {
+void uring_drive_channel::prep_linked_flush(drive_iocb* iocb, struct io_uring_sqe* write_sqe) {
+    // Space for both sqes is reserved before the write is prepared
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+    RELEASE_ASSERT_NOTNULL((void*)sqe, "No sqe available for the flush linked to write iocb={}", iocb->to_string());
+
+    // Flush is started only after write is successful, if write fails or is short, flush is cancelled
+    write_sqe->flags |= IOSQE_IO_LINK;
+    io_uring_prep_fsync(sqe, iocb->iodev->fd(), IORING_FSYNC_DATASYNC);
+    set_fixed_file(iocb->iodev, sqe);
+    io_uring_sqe_set_data(sqe, (void*)(r_cast< uintptr_t >(iocb) | linked_flush_tag));
+    ++m_prepared_ios;
+}
+
+void uring_drive_channel::prep_sqe_from_iocb(drive_iocb* iocb, struct io_uring_sqe* sqe) {
+    // Buffers carved out of registered memory can be issued as fixed buffer IOs, avoiding the page pinning in kernel.
+    // Kernel supports only a single buffer for fixed IOs, so vectored IOs with more than one iov take regular path.
+    void* buf{nullptr};
+    int buf_idx{-1};
+    if ((m_fixed_bufs != nullptr) && ((iocb->op_type == DriveOpType::WRITE) || (iocb->op_type == DriveOpType::READ))) {
+        if (!iocb->has_iovs()) {
+            buf = (void*)iocb->get_data();
+        } else if (iocb->iovcnt == 1) {
+            buf = iocb->get_iovs()[0].iov_base;
+        }
+        if (buf != nullptr) { buf_idx = m_fixed_bufs->fixed_buf_index(buf, iocb->size); }
+    }
+
     switch (iocb->op_type) {
     case DriveOpType::WRITE:
-        if (iocb->has_iovs()) {
+        if (buf_idx >= 0) {
+            io_uring_prep_write_fixed(sqe, iocb->iodev->fd(), (const void*)buf, iocb->size, iocb->offset, buf_idx);
+        } else if (iocb->has_iovs()) {
             io_uring_prep_writev(sqe, iocb->iodev->fd(), iocb->get_iovs(), iocb->iovcnt, iocb->offset);
         } else {
             io_uring_prep_write(sqe, iocb->iodev->fd(), (const void*)iocb->get_data(), iocb->size, iocb->offset);
@@ -111,7 +273,9 @@ static void prep_sqe_from_iocb(drive_iocb* iocb, struct io_uring_sqe* sqe) {
         break;
 
     case DriveOpType::READ:
-        if (iocb->has_iovs()) {
+        if (buf_idx >= 0) {
+            io_uring_prep_read_fixed(sqe, iocb->iodev->fd(), buf, iocb->size, iocb->offset, buf_idx);
+        } else if (iocb->has_iovs()) {
             io_uring_prep_readv(sqe, iocb->iodev->fd(), iocb->get_iovs(), iocb->iovcnt, iocb->offset);
         } else {
             io_uring_prep_read(sqe, iocb->iodev->fd(), (void*)iocb->get_data(), iocb->size, iocb->offset);
@@ -122,23 +286,69 @@ static void prep_sqe_from_iocb(drive_iocb* iocb, struct io_uring_sqe* sqe) {
         io_uring_prep_fsync(sqe, iocb->iodev->fd(), IORING_FSYNC_DATASYNC);
         break;
 
+    case DriveOpType::UNMAP:
+    case DriveOpType::WRITE_ZERO:
+        // Large ranges are issued one chunk at a time, the next chunk is submitted on completion of previous one
+        io_uring_prep_fallocate(sqe, iocb->iodev->fd(),
+                                KernelDriveInterface::fallocate_mode(iocb->iodev, iocb->op_type), iocb->offset,
+                                m_iface->range_chunk_size(iocb));
+        break;
+
     default:
         break;
     }
+
+    set_fixed_file(iocb->iodev, sqe);
 }
 
-bool uring_drive_channel::can_submit() const {
-    return (m_in_flight_ios + m_prepared_ios) <= UringDriveInterface::per_thread_qdepth;
+void uring_drive_channel::set_fixed_file(IODevice* iodev, struct io_uring_sqe* sqe) {
+    if (const auto slot = fixed_file_slot(iodev); slot >= 0) {
+        sqe->fd = slot;
+        sqe->flags |= IOSQE_FIXED_FILE;
+    }
+}
+
+int uring_drive_channel::fixed_file_slot(IODevice* iodev) {
+    const auto slot = iodev->fixed_file_idx;
+    if ((slot < 0) || (s_cast< size_t >(slot) >= m_fixed_files.size())) { return -1; }
+
+    if (sisl_unlikely(m_fixed_files[slot] != iodev->fd())) {
+        // First IO of this device on this ring, update the table
+        int fd = iodev->fd();
+        const auto ret = io_uring_register_files_update(&m_ring, slot, &fd, 1);
+        if (ret != 1) {
+            LOGWARNMOD(iomgr, "Unable to update fixed file slot={} with fd={} ret={}", slot, fd, ret);
+            return -1;
+        }
+        m_fixed_files[slot] = fd;
+    }
+    return slot;
+}
+
+void uring_drive_channel::unregister_fixed_file(int32_t slot) {
+    if ((slot < 0) || (s_cast< size_t >(slot) >= m_fixed_files.size()) || (m_fixed_files[slot] == -1)) { return; }
+
+    int fd = -1;
+    const auto ret = io_uring_register_files_update(&m_ring, slot, &fd, 1);
+    if (ret != 1) { LOGWARNMOD(iomgr, "Unable to clear fixed file slot={} ret={}", slot, ret); }
+    m_fixed_files[slot] = -1;
+}
+
+bool uring_drive_channel::can_submit(uint32_t nsqes) const {
+    return (m_in_flight_ios + m_prepared_ios + nsqes) <= m_cq_depth;
 }
 
 void uring_drive_channel::drain_waitq() {
     while (m_iocb_waitq.size() != 0) {
-        if (!can_submit()) { break; };
+        const auto nsqes = sqes_needed(m_iocb_waitq.front());
+        if (!can_submit(nsqes)) { break; };
+        if (io_uring_sq_space_left(&m_ring) < nsqes) {
+            // Flush the batched ios to make room. With sqpoll, kernel poller might not have consumed the sq yet, in
+            // which case rest is drained on next completion.
+            submit_ios();
+            if (io_uring_sq_space_left(&m_ring) < nsqes) { return; }
+        }
         struct io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
-        if (sqe == nullptr) {
-            DEBUG_ASSERT(false, "Don't expect sqe to be full or unavailable");
-            return;
-        };
 
         drive_iocb* iocb = pop_waitq();
         prep_sqe_from_iocb(iocb, sqe);
@@ -148,19 +358,69 @@ void uring_drive_channel::drain_waitq() {
 
 ///////////////////////////// UringDriveInterface /////////////////////////////////////////
 UringDriveInterface::UringDriveInterface(const bool new_interface_supported, const io_interface_comp_cb_t& cb) :
-        KernelDriveInterface(cb), m_new_intfc(new_interface_supported) {}
+        KernelDriveInterface(cb),
+        m_new_intfc(new_interface_supported),
+        m_fixed_file_reserver(std::max(IM_DYNAMIC_CONFIG(uring.max_fixed_files), 1u)) {
+    struct io_uring_probe* probe = io_uring_get_probe();
+    if (probe != nullptr) {
+        m_fallocate_supported = io_uring_opcode_supported(probe, IORING_OP_FALLOCATE);
+        io_uring_free_probe(probe);
+    }
+    if (!m_fallocate_supported) {
+        LOGINFOMOD(iomgr, "Kernel uring doesn't support fallocate, unmap and write zero will not be async");
+    }
 
-void UringDriveInterface::init_iface_reactor_context(IOReactor*) {
-    if (t_uring_ch == nullptr) { t_uring_ch = new uring_drive_channel(this); }
+    // Pool is created by the iomanager on start, along with the allocator which serves iobufs from it
+    if (auto alloc = dynamic_cast< UringAlignedAllocImpl* >(&sisl::AlignedAllocator::allocator())) {
+        m_fixed_bufs = alloc->pool();
+    }
+}
+
+void UringDriveInterface::init_iface_reactor_context(IOReactor* reactor) {
+    if (t_uring_ch == nullptr) {
+        t_uring_ch = new uring_drive_channel(this, false /* iopoll */);
+        if (reactor->is_worker() && (t_uring_ch->m_submit_q != nullptr)) { register_submit_ring(t_uring_ch); }
+    }
+    if ((t_iopoll_ch == nullptr) && IM_DYNAMIC_CONFIG(uring.iopoll)) {
+        try {
+            t_iopoll_ch = new uring_drive_channel(this, true /* iopoll */);
+        } catch (const std::exception& e) {
+            LOGWARNMOD(iomgr, "Unable to create polled uring, IOs will be completed by interrupts: {}", e.what());
+        }
+    }
 }
 
 void UringDriveInterface::clear_iface_reactor_context(IOReactor*) {
+    if (t_iopoll_ch != nullptr) {
+        delete t_iopoll_ch;
+        t_iopoll_ch = nullptr;
+    }
     if (t_uring_ch != nullptr) {
+        unregister_submit_ring(t_uring_ch);
         delete t_uring_ch;
         t_uring_ch = nullptr;
     }
 }
 
+void UringDriveInterface::register_submit_ring(uring_drive_channel* ch) {
+    std::unique_lock lg{m_submit_rings_mtx};
+    m_submit_rings.push_back(ch);
+}
+
+void UringDriveInterface::unregister_submit_ring(uring_drive_channel* ch) {
+    {
+        std::unique_lock lg{m_submit_rings_mtx};
+        std::erase(m_submit_rings, ch);
+    }
+    if (ch->m_submit_q == nullptr) { return; }
+
+    // No more IOs can be queued to this ring, hand over the leftovers to other reactors
+    drive_iocb* iocb;
+    while (ch->m_submit_q->read(iocb)) {
+        iomanager.run_on_forget(reactor_regex::random_worker, [this, iocb]() { submit_io(iocb, false); });
+    }
+}
+
 io_device_ptr UringDriveInterface::open_dev(const std::string& devname, drive_type dev_type, int oflags) {
     LOGMSG_ASSERT(((dev_type == drive_type::block_nvme) || (dev_type == drive_type::block_hdd) ||
                    (dev_type == drive_type::file_on_hdd) || (dev_type == drive_type::file_on_nvme)),
@@ -179,6 +439,20 @@ io_device_ptr UringDriveInterface::open_dev(const std::string& devname, drive_ty
     iodev->creator = iomanager.am_i_io_reactor() ? iomanager.iofiber_self() : nullptr;
     iodev->dtype = dev_type;
 
+    // Polling for completion is only possible on O_DIRECT IOs to a block device whose driver supports polling
+    iodev->polled_io = IM_DYNAMIC_CONFIG(uring.iopoll) && (dev_type == drive_type::block_nvme) && (oflags & O_DIRECT);
+
+    // Reserve a slot in the fixed file table. Each ring registers the fd in this slot lazily on its first IO.
+    if (IM_DYNAMIC_CONFIG(uring.max_fixed_files) != 0) {
+        const auto slot = m_fixed_file_reserver.reserve();
+        if (slot < IM_DYNAMIC_CONFIG(uring.max_fixed_files)) {
+            iodev->fixed_file_idx = s_cast< int32_t >(slot);
+        } else {
+            m_fixed_file_reserver.unreserve(slot);
+            LOGINFOMOD(iomgr, "Fixed file table is full, device={} will not use fixed file", devname);
+        }
+    }
+
     // We don't need to add the device to each thread, because each AioInterface thread context add an
     // event fd and read/write use this device fd to control with iocb.
     LOGINFOMOD(iomgr, "Device={} of type={} opened with flags={} successfully, fd={}", devname, dev_type, oflags, fd);
@@ -186,16 +460,74 @@ io_device_ptr UringDriveInterface::open_dev(const std::string& devname, drive_ty
 }
 
 void UringDriveInterface::close_dev(const io_device_ptr& iodev) {
+    DriveInterface::stop_qos(iodev.get());
     // TODO: This is where we would wait for any outstanding io's to complete
 
     IOInterface::close_dev(iodev);
     // reset counters
     LOGINFOMOD(iomgr, "Device {} close device", iodev->devname);
+    if (iodev->fixed_file_idx >= 0) { release_fixed_file(iodev.get()); }
+
     // AIO base devices are not added to any poll list, so it can be closed as is.
     close(iodev->fd());
     iodev->clear();
 }
 
+bool UringDriveInterface::fill_sqpoll_params(struct io_uring_params& params, bool attach) {
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = IM_DYNAMIC_CONFIG(uring.sqpoll_idle_ms);
+    if (const auto cpu = IM_DYNAMIC_CONFIG(uring.sqpoll_cpu); cpu >= 0) {
+        params.flags |= IORING_SETUP_SQ_AFF;
+        params.sq_thread_cpu = s_cast< uint32_t >(cpu);
+    }
+
+    if (attach) {
+        if (!IM_DYNAMIC_CONFIG(uring.sqpoll_shared)) { return false; }
+        std::unique_lock lg{m_sqpoll_mtx};
+        if (m_sqpoll_wq_fd == -1) { return false; }
+        params.flags |= IORING_SETUP_ATTACH_WQ;
+        params.wq_fd = s_cast< uint32_t >(m_sqpoll_wq_fd);
+    }
+    return true;
+}
+
+void UringDriveInterface::on_sqpoll_ring_created(int ring_fd) {
+    if (!IM_DYNAMIC_CONFIG(uring.sqpoll_shared)) { return; }
+    std::unique_lock lg{m_sqpoll_mtx};
+    if (m_sqpoll_wq_fd == -1) { m_sqpoll_wq_fd = ring_fd; }
+}
+
+void UringDriveInterface::on_sqpoll_ring_destroyed(int ring_fd) {
+    // Rings already attached keep the poller alive, but new rings can't attach to a closed fd. The next ring
+    // created will start a new shared poller.
+    std::unique_lock lg{m_sqpoll_mtx};
+    if (m_sqpoll_wq_fd == ring_fd) { m_sqpoll_wq_fd = -1; }
+}
+
+void UringDriveInterface::release_fixed_file(IODevice* iodev) {
+    const int32_t slot = iodev->fixed_file_idx;
+    iodev->fixed_file_idx = -1;
+
+    // Slot can be reused only after every ring has dropped the file, otherwise a new device getting the same fd
+    // number could be served by the stale file registered in that slot.
+    if (iomanager.am_i_sync_io_capable()) {
+        iomanager.run_on_wait(reactor_regex::all_io, [slot]() {
+            if (t_uring_ch) { t_uring_ch->unregister_fixed_file(slot); }
+            if (t_iopoll_ch) { t_iopoll_ch->unregister_fixed_file(slot); }
+        });
+        m_fixed_file_reserver.unreserve(slot);
+    } else {
+        auto pending = std::make_shared< std::atomic< int32_t > >(0);
+        const int32_t sent = iomanager.run_on_forget(reactor_regex::all_io, [this, slot, pending]() {
+            if (t_uring_ch) { t_uring_ch->unregister_fixed_file(slot); }
+            if (t_iopoll_ch) { t_iopoll_ch->unregister_fixed_file(slot); }
+            if (pending->fetch_sub(1) == 1) { m_fixed_file_reserver.unreserve(slot); }
+        });
+        if (pending->fetch_add(sent) == -sent) { m_fixed_file_reserver.unreserve(slot); }
+    }
+}
+
 folly::Future< std::error_code > UringDriveInterface::async_write(IODevice* iodev, const char* data, uint32_t size,
                                                                   uint64_t offset, bool part_of_batch) {
     if (!m_new_intfc) {
@@ -206,52 +538,22 @@ folly::Future< std::error_code > UringDriveInterface::async_write(IODevice* iode
         return async_writev(iodev, iov.data(), 1, size, offset, part_of_batch);
     } else {
         // io_uring_prep_write available starts from kernel 5.6
-        auto iocb = new drive_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+        auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
         iocb->set_data((char*)data);
         iocb->completion = std::move(folly::Promise< std::error_code >{});
         auto ret = iocb->folly_comp_promise().getFuture();
-
-        auto submit_in_this_thread = [this](drive_iocb* iocb, bool part_of_batch) {
-            DriveInterface::increment_outstanding_counter(iocb);
-            auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-            if (sqe == nullptr) { return; }
-
-            io_uring_prep_write(sqe, iocb->iodev->fd(), (const void*)iocb->get_data(), iocb->size, iocb->offset);
-            t_uring_ch->submit_if_needed(iocb, sqe, part_of_batch);
-        };
-
-        if (iomanager.this_reactor() != nullptr) {
-            submit_in_this_thread(iocb, part_of_batch);
-        } else {
-            iomanager.run_on_forget(reactor_regex::random_worker,
-                                    [=]() { submit_in_this_thread(iocb, part_of_batch); });
-        }
-
+        submit_async_io(iocb, part_of_batch);
         return ret;
     }
 }
 
 folly::Future< std::error_code > UringDriveInterface::async_writev(IODevice* iodev, const iovec* iov, int iovcnt,
                                                                    uint32_t size, uint64_t offset, bool part_of_batch) {
-    auto iocb = new drive_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
     iocb->set_iovs(iov, iovcnt);
     iocb->completion = std::move(folly::Promise< std::error_code >{});
     auto ret = iocb->folly_comp_promise().getFuture();
-
-    auto submit_in_this_thread = [this](drive_iocb* iocb, bool part_of_batch) {
-        DriveInterface::increment_outstanding_counter(iocb);
-        auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-        if (sqe == nullptr) { return; }
-
-        io_uring_prep_writev(sqe, iocb->iodev->fd(), iocb->get_iovs(), iocb->iovcnt, iocb->offset);
-        t_uring_ch->submit_if_needed(iocb, sqe, part_of_batch);
-    };
-
-    if (iomanager.this_reactor() != nullptr) {
-        submit_in_this_thread(iocb, part_of_batch);
-    } else {
-        iomanager.run_on_forget(reactor_regex::random_worker, [=]() { submit_in_this_thread(iocb, part_of_batch); });
-    }
+    submit_async_io(iocb, part_of_batch);
     return ret;
 }
 
@@ -264,86 +566,137 @@ folly::Future< std::error_code > UringDriveInterface::async_read(IODevice* iodev
 
         return async_readv(iodev, iov.data(), 1, size, offset, part_of_batch);
     } else {
-        auto iocb = new drive_iocb(this, iodev, DriveOpType::READ, size, offset);
+        auto iocb = alloc_iocb(this, iodev, DriveOpType::READ, size, offset);
         iocb->set_data(data);
         iocb->completion = std::move(folly::Promise< std::error_code >{});
         auto ret = iocb->folly_comp_promise().getFuture();
-
-        auto submit_in_this_thread = [this](drive_iocb* iocb, bool part_of_batch) {
-            DriveInterface::increment_outstanding_counter(iocb);
-            auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-            if (sqe == nullptr) { return; }
-
-            io_uring_prep_read(sqe, iocb->iodev->fd(), (void*)iocb->get_data(), iocb->size, iocb->offset);
-            t_uring_ch->submit_if_needed(iocb, sqe, part_of_batch);
-        };
-
-        if (iomanager.this_reactor() != nullptr) {
-            submit_in_this_thread(iocb, part_of_batch);
-        } else {
-            iomanager.run_on_forget(reactor_regex::random_worker,
-                                    [=]() { submit_in_this_thread(iocb, part_of_batch); });
-        }
+        submit_async_io(iocb, part_of_batch);
         return ret;
     }
 }
 
 folly::Future< std::error_code > UringDriveInterface::async_readv(IODevice* iodev, const iovec* iov, int iovcnt,
                                                                   uint32_t size, uint64_t offset, bool part_of_batch) {
-    auto iocb = new drive_iocb(this, iodev, DriveOpType::READ, size, offset);
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::READ, size, offset);
     iocb->set_iovs(iov, iovcnt);
     iocb->completion = std::move(folly::Promise< std::error_code >{});
     auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, part_of_batch);
+    return ret;
+}
 
-    auto submit_in_this_thread = [this](drive_iocb* iocb, bool part_of_batch) {
-        DriveInterface::increment_outstanding_counter(iocb);
-        auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-        if (sqe == nullptr) { return; }
+void UringDriveInterface::async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset,
+                                         const drive_comp_cb& cb, bool part_of_batch) {
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+    if (m_new_intfc) {
+        iocb->set_data((char*)data);
+    } else {
+        const iovec iov{(void*)data, size};
+        iocb->set_iovs(&iov, 1);
+    }
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
 
-        io_uring_prep_readv(sqe, iocb->iodev->fd(), iocb->get_iovs(), iocb->iovcnt, iocb->offset);
-        t_uring_ch->submit_if_needed(iocb, sqe, part_of_batch);
-    };
+void UringDriveInterface::async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
+                                          uint64_t offset, const drive_comp_cb& cb, bool part_of_batch) {
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_iovs(iov, iovcnt);
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
 
-    if (iomanager.this_reactor() != nullptr) {
-        submit_in_this_thread(iocb, part_of_batch);
+void UringDriveInterface::async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset,
+                                        const drive_comp_cb& cb, bool part_of_batch) {
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::READ, size, offset);
+    if (m_new_intfc) {
+        iocb->set_data(data);
     } else {
-        iomanager.run_on_forget(reactor_regex::random_worker, [=]() { submit_in_this_thread(iocb, part_of_batch); });
+        const iovec iov{(void*)data, size};
+        iocb->set_iovs(&iov, 1);
     }
-    return ret;
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
+}
+
+void UringDriveInterface::async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
+                                         uint64_t offset, const drive_comp_cb& cb, bool part_of_batch) {
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::READ, size, offset);
+    iocb->set_iovs(iov, iovcnt);
+    iocb->completion = cb;
+    submit_async_io(iocb, part_of_batch);
 }
 
 folly::Future< std::error_code > UringDriveInterface::async_unmap(IODevice* iodev, uint32_t size, uint64_t offset,
                                                                   bool part_of_batch) {
-    RELEASE_ASSERT(0, "async_unmap is not supported for uring yet");
-    return folly::makeFuture< std::error_code >(std::error_code(ENOTSUP, std::system_category()));
+    if (!m_fallocate_supported) {
+        return folly::makeFuture< std::error_code >(std::error_code(ENOTSUP, std::system_category()));
+    }
+
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::UNMAP, size, offset);
+    iocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, part_of_batch);
+    return ret;
 }
 
 folly::Future< std::error_code > UringDriveInterface::async_write_zero(IODevice* iodev, uint64_t size,
                                                                        uint64_t offset) {
-    LOGWARN("Uring async_write_zero is implemented as sync write, need to have more intelligent implementation");
-    auto ret = sync_write_zero(iodev, size, offset);
-    return folly::makeFuture< std::error_code >(std::move(ret));
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE_ZERO, size, offset);
+    iocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = iocb->folly_comp_promise().getFuture();
+    if (!m_fallocate_supported) {
+        // Kernel doesn't support uring fallocate, write the zeros in offload thread instead of blocking the reactor
+        DriveInterface::increment_outstanding_counter(iocb);
+        offload_io(
+            iocb,
+            [this](drive_iocb* iocb) -> int64_t {
+                const auto err = sync_write_zero(iocb->iodev, iocb->size, iocb->offset);
+                return err ? -err.value() : 0;
+            },
+            [this](drive_iocb* iocb) { finish_io(iocb); });
+        return ret;
+    }
+
+    submit_async_io(iocb, false /* part_of_batch */);
+    return ret;
 }
 
 folly::Future< std::error_code > UringDriveInterface::queue_fsync(IODevice* iodev) {
-    auto iocb = new drive_iocb(this, iodev, DriveOpType::FSYNC, 0, 0);
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::FSYNC, 0, 0);
     iocb->completion = std::move(folly::Promise< std::error_code >{});
     auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, false /* part_of_batch */);
+    return ret;
+}
 
-    auto submit_in_this_thread = [this](drive_iocb* iocb) {
-        DriveInterface::increment_outstanding_counter(iocb);
-        auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-        if (sqe == nullptr) { return; }
-
-        io_uring_prep_fsync(sqe, iocb->iodev->fd(), IORING_FSYNC_DATASYNC);
-        t_uring_ch->submit_if_needed(iocb, sqe, false /* batching */);
-    };
+folly::Future< std::error_code > UringDriveInterface::async_write_durable(IODevice* iodev, const char* data,
+                                                                          uint32_t size, uint64_t offset) {
+    if (!m_new_intfc) {
+        std::array< iovec, 1 > iov;
+        iov[0].iov_base = (void*)data;
+        iov[0].iov_len = size;
 
-    if (iomanager.this_reactor() != nullptr) {
-        submit_in_this_thread(iocb);
-    } else {
-        iomanager.run_on_forget(reactor_regex::random_worker, [=]() { submit_in_this_thread(iocb); });
+        return async_writev_durable(iodev, iov.data(), 1, size, offset);
     }
+
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_data((char*)data);
+    iocb->durable = true;
+    iocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, false /* part_of_batch */);
+    return ret;
+}
+
+folly::Future< std::error_code > UringDriveInterface::async_writev_durable(IODevice* iodev, const iovec* iov,
+                                                                           int iovcnt, uint32_t size, uint64_t offset) {
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+    iocb->set_iovs(iov, iovcnt);
+    iocb->durable = true;
+    iocb->completion = std::move(folly::Promise< std::error_code >{});
+    auto ret = iocb->folly_comp_promise().getFuture();
+    submit_async_io(iocb, false /* part_of_batch */);
     return ret;
 }
 
@@ -359,17 +712,11 @@ std::error_code UringDriveInterface::sync_write(IODevice* iodev, const char* dat
 
         return sync_writev(iodev, iov.data(), 1, size, offset);
     } else {
-        auto iocb = new drive_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+        auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
         iocb->set_data((char*)data);
         iocb->completion = std::move(FiberManagerLib::Promise< std::error_code >{});
         auto f = iocb->fiber_comp_promise().getFuture();
-
-        DriveInterface::increment_outstanding_counter(iocb);
-        auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-        assert(sqe);
-
-        io_uring_prep_write(sqe, iodev->fd(), (const void*)iocb->get_data(), iocb->size, offset);
-        t_uring_ch->submit_if_needed(iocb, sqe, false);
+        submit_io(iocb, false /* part_of_batch */);
         return f.get();
     }
 }
@@ -380,17 +727,11 @@ std::error_code UringDriveInterface::sync_writev(IODevice* iodev, const iovec* i
         return KernelDriveInterface::sync_writev(iodev, iov, iovcnt, size, offset);
     }
 
-    auto iocb = new drive_iocb(this, iodev, DriveOpType::WRITE, size, offset);
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::WRITE, size, offset);
     iocb->set_iovs(iov, iovcnt);
     iocb->completion = std::move(FiberManagerLib::Promise< std::error_code >{});
     auto f = iocb->fiber_comp_promise().getFuture();
-
-    DriveInterface::increment_outstanding_counter(iocb);
-    auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-    assert(sqe);
-
-    io_uring_prep_writev(sqe, iodev->fd(), iocb->get_iovs(), iocb->iovcnt, offset);
-    t_uring_ch->submit_if_needed(iocb, sqe, false);
+    submit_io(iocb, false /* part_of_batch */);
     return f.get();
 }
 
@@ -406,17 +747,11 @@ std::error_code UringDriveInterface::sync_read(IODevice* iodev, char* data, uint
 
         return sync_readv(iodev, iov.data(), 1, size, offset);
     } else {
-        auto iocb = new drive_iocb(this, iodev, DriveOpType::READ, size, offset);
+        auto iocb = alloc_iocb(this, iodev, DriveOpType::READ, size, offset);
         iocb->set_data(data);
         iocb->completion = std::move(FiberManagerLib::Promise< std::error_code >{});
         auto f = iocb->fiber_comp_promise().getFuture();
-
-        DriveInterface::increment_outstanding_counter(iocb);
-        auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-        assert(sqe);
-
-        io_uring_prep_read(sqe, iodev->fd(), (void*)iocb->get_data(), iocb->size, offset);
-        t_uring_ch->submit_if_needed(iocb, sqe, false);
+        submit_io(iocb, false /* part_of_batch */);
         return f.get();
     }
 }
@@ -426,21 +761,153 @@ std::error_code UringDriveInterface::sync_readv(IODevice* iodev, const iovec* io
     if (!iomanager.am_i_sync_io_capable() || (t_uring_ch == nullptr) || !t_uring_ch->can_submit()) {
         return KernelDriveInterface::sync_readv(iodev, iov, iovcnt, size, offset);
     }
-    auto iocb = new drive_iocb(this, iodev, DriveOpType::READ, size, offset);
+    auto iocb = alloc_iocb(this, iodev, DriveOpType::READ, size, offset);
     iocb->set_iovs(iov, iovcnt);
     iocb->completion = std::move(FiberManagerLib::Promise< std::error_code >{});
     auto f = iocb->fiber_comp_promise().getFuture();
+    submit_io(iocb, false /* part_of_batch */);
+    return f.get();
+}
 
+uring_drive_channel* UringDriveInterface::channel_for(const drive_iocb* iocb) {
+    // Polled ring supports only read/write, rest of the ops (including the flush of durable write) on the device go
+    // through the regular ring
+    if ((t_iopoll_ch != nullptr) && iocb->iodev->polled_io && !iocb->durable &&
+        ((iocb->op_type == DriveOpType::READ) || (iocb->op_type == DriveOpType::WRITE))) {
+        return t_iopoll_ch;
+    }
+    return t_uring_ch;
+}
+
+void UringDriveInterface::submit_io(drive_iocb* iocb, bool part_of_batch) {
+    if (part_of_batch && !iocb->durable &&
+        ((iocb->op_type == DriveOpType::READ) || (iocb->op_type == DriveOpType::WRITE)) && io_merge_enabled()) {
+        t_merge_q.push_back(iocb);
+        return;
+    }
+    issue_io(iocb, part_of_batch);
+}
+
+static void on_merged_io_completion(std::error_code err, void* cookie) {
+    auto merged = r_cast< drive_iocb* >(cookie);
+    for_each_merged_member(merged, [merged](drive_iocb* m) {
+        m->result = (merged->result >= 0) ? s_cast< int64_t >(m->size) : merged->result;
+        m->complete(err);
+        slab_delete(m);
+    });
+}
+
+void UringDriveInterface::flush_merge_q() {
+    if (t_merge_q.empty()) { return; }
+
+    // Taken out, since a failed submission could complete ios and batch more from within
+    std::vector< drive_iocb* > iocbs;
+    iocbs.swap(t_merge_q);
+    merge_batch_ios(iocbs, [this](drive_iocb* first, uint64_t size) {
+        auto merged = alloc_iocb(this, first->iodev, first->op_type, size, first->offset);
+        merged->completion = drive_comp_cb{on_merged_io_completion, (void*)merged};
+        return merged;
+    });
+    for (auto iocb : iocbs) {
+        issue_io(iocb, true /* part_of_batch */);
+    }
+    if (t_merge_q.empty()) {
+        iocbs.clear();
+        t_merge_q.swap(iocbs);
+    }
+}
+
+void UringDriveInterface::issue_io(drive_iocb* iocb, bool part_of_batch) {
     DriveInterface::increment_outstanding_counter(iocb);
-    auto sqe = t_uring_ch->get_sqe_or_enqueue(iocb);
-    assert(sqe);
+    auto ch = channel_for(iocb);
+    auto sqe = ch->get_sqe_or_enqueue(iocb);
+    if (sqe == nullptr) { return; }
 
-    io_uring_prep_readv(sqe, iodev->fd(), iocb->get_iovs(), iocb->iovcnt, offset);
-    t_uring_ch->submit_if_needed(iocb, sqe, false);
-    return f.get();
+    ch->prep_sqe_from_iocb(iocb, sqe);
+    ch->submit_if_needed(iocb, sqe, part_of_batch);
+}
+
+void UringDriveInterface::submit_async_io(drive_iocb* iocb, bool part_of_batch) {
+    if (!DriveInterface::qos_admit(iocb)) { return; }
+    if (iomanager.this_reactor() != nullptr) {
+        submit_io(iocb, part_of_batch);
+    } else if (!queue_to_reactor(iocb)) {
+        // Batch can't be submitted from outside the reactor, so the reactor submits it right away
+        iomanager.run_on_forget(reactor_regex::random_worker, [this, iocb]() { submit_io(iocb, false); });
+    }
+}
+
+void UringDriveInterface::submit_qos_admitted(drive_iocb* iocb) { submit_async_io(iocb, false /* part_of_batch */); }
+
+bool UringDriveInterface::queue_to_reactor(drive_iocb* iocb) {
+    // Each thread sticks to one reactor, so that its IOs get drained together with a single wakeup
+    static std::atomic< uint32_t > s_next_ring{0};
+    static thread_local uint32_t t_ring_idx{s_next_ring.fetch_add(1, std::memory_order_relaxed)};
+
+    std::shared_lock lg{m_submit_rings_mtx};
+    if (m_submit_rings.empty()) { return false; }
+    if (!m_submit_rings[t_ring_idx % m_submit_rings.size()]->queue_from_remote(iocb)) {
+        ++t_ring_idx; // Move on to the next reactor, since this one is not keeping up
+        COUNTER_INCREMENT(m_metrics, submit_ring_full, 1);
+        return false;
+    }
+    COUNTER_INCREMENT(m_metrics, submit_ring_ios, 1);
+    return true;
+}
+
+void UringDriveInterface::drain_submit_ring() {
+    auto ch = t_uring_ch;
+    if ((ch->m_submit_q == nullptr) || !ch->m_wakeup_pending.load(std::memory_order_relaxed)) { return; }
+
+    ch->m_wakeup_pending.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // Bounded to the ring depth, so that remote threads can't keep the reactor here forever
+    const auto max_count = ch->m_submit_q->capacity();
+    drive_iocb* iocb;
+    size_t count{0};
+    while ((count < max_count) && ch->m_submit_q->read(iocb)) {
+        submit_io(iocb, true /* part_of_batch */);
+        ++count;
+    }
+    if (count == max_count) { ch->m_wakeup_pending.store(true); } // Rest of them are picked on next loop
+    if (count != 0) { submit_batch(); }
+}
+
+void UringDriveInterface::async_submit(std::span< const drive_io_request > reqs) {
+    // From outside the reactors, all of them land in the submit ring of one reactor and are drained together
+    for (const auto& req : reqs) {
+        const bool needs_fallocate = (req.op_type == DriveOpType::UNMAP) || (req.op_type == DriveOpType::WRITE_ZERO);
+        if (!req.is_valid() || (needs_fallocate && !m_fallocate_supported)) {
+            submit_request(req, true /* part_of_batch */);
+            continue;
+        }
+
+        const bool is_fsync = (req.op_type == DriveOpType::FSYNC);
+        auto iocb = alloc_iocb(this, req.iodev, req.op_type, is_fsync ? 0 : req.size, is_fsync ? 0 : req.offset);
+        if ((req.op_type == DriveOpType::READ) || (req.op_type == DriveOpType::WRITE)) {
+            if (req.data == nullptr) {
+                iocb->set_iovs(req.iov, req.iovcnt);
+            } else if (m_new_intfc) {
+                iocb->set_data(req.data);
+            } else {
+                const iovec iov{(void*)req.data, req.size};
+                iocb->set_iovs(&iov, 1);
+            }
+        }
+        iocb->completion = req.cb;
+        submit_async_io(iocb, true /* part_of_batch */);
+    }
+    submit_batch();
 }
 
-void UringDriveInterface::submit_batch() { t_uring_ch->submit_ios(); }
+void UringDriveInterface::submit_batch() {
+    // IOs queued from outside the reactors are submitted by the reactor draining them
+    if (t_uring_ch == nullptr) { return; }
+    flush_merge_q();
+    t_uring_ch->submit_ios();
+    if (t_iopoll_ch != nullptr) { t_iopoll_ch->submit_ios(); }
+}
 
 void UringDriveInterface::on_event_notification(IODevice* iodev, [[maybe_unused]] void* cookie,
                                                 [[maybe_unused]] int event) {
@@ -451,95 +918,162 @@ void UringDriveInterface::on_event_notification(IODevice* iodev, [[maybe_unused]
 }
 
 void UringDriveInterface::handle_completions() {
+    if (t_iopoll_ch != nullptr) {
+        // Polled ring doesn't raise any event, so it is reaped on every loop of the reactor
+        t_iopoll_ch->poll_device();
+        handle_completions(t_iopoll_ch);
+    }
+    handle_completions(t_uring_ch);
+    drain_submit_ring();
+}
+
+void UringDriveInterface::handle_completions(uring_drive_channel* ch) {
+    std::array< struct io_uring_cqe*, uring_drive_channel::max_cqe_batch > cqes;
+    std::array< drive_iocb*, uring_drive_channel::max_cqe_batch > iocbs;
+    std::array< int32_t, uring_drive_channel::max_cqe_batch > results;
+    std::array< bool, uring_drive_channel::max_cqe_batch > is_flush;
+
+    uint32_t count{0};
     do {
-        struct io_uring_cqe* cqe;
-        int ret = io_uring_peek_cqe(&t_uring_ch->m_ring, &cqe);
-        if (sisl_unlikely(*(t_uring_ch->m_ring.cq.koverflow))) {
-            COUNTER_INCREMENT(m_metrics, overflow_errors, 1);
-            COUNTER_INCREMENT(m_metrics, num_of_drops, *(t_uring_ch->m_ring.cq.koverflow));
-            folly::throwSystemError(fmt::format("CQ overflow - number of dropped io requests : {} - {}",
-                                                *(t_uring_ch->m_ring.cq.koverflow), strerror(errno)));
-            break;
+        // Picking the batch also flushes any completions kernel had to hold back on an overflowed CQ
+        count = io_uring_peek_batch_cqe(&ch->m_ring, cqes.data(), cqes.size());
+        for (uint32_t i{0}; i < count; ++i) {
+            const auto tagged = r_cast< uintptr_t >(io_uring_cqe_get_data(cqes[i]));
+            iocbs[i] = r_cast< drive_iocb* >(tagged & ~uring_drive_channel::linked_flush_tag);
+            is_flush[i] = (tagged & uring_drive_channel::linked_flush_tag);
+            results[i] = cqes[i]->res;
         }
-        if (sisl_unlikely(ret < 0)) {
-            if (ret != -EAGAIN) {
-                COUNTER_INCREMENT(m_metrics, completion_errors, 1);
-                folly::throwSystemError(fmt::format("io_uring_wait_cqe throw error={}", strerror(errno)));
+        io_uring_cq_advance(&ch->m_ring, count);
+        // Don't access cqes beyond this point.
+
+        ch->check_overflow(m_metrics);
+        if (count == 0) { break; }
+        COUNTER_INCREMENT(m_metrics, total_io_callbacks, 1);
+
+        for (uint32_t i{0}; i < count; ++i) {
+            auto iocb = iocbs[i];
+            if (iocb->durable) {
+                if (!handle_durable_completion(ch, iocb, results[i], is_flush[i])) { continue; }
             } else {
-                LOGTRACEMOD(iomgr, "Received EAGAIN on uring peek cqe");
+                iocb->result = results[i];
             }
-            break;
-        }
-        if (cqe == nullptr) { break; }
-
-        auto iocb = (drive_iocb*)io_uring_cqe_get_data(cqe);
-        iocb->result = cqe->res;
-        io_uring_cqe_seen(&t_uring_ch->m_ring, cqe);
-
-        // Don't access cqe beyond this point.
-        if (sisl_likely(iocb->result >= 0)) {
-            if (sisl_likely(static_cast< uint64_t >(iocb->result) == iocb->size)) {
-                // all read buffer is filled by uring;
-                LOGDEBUGMOD(iomgr, "Received completion event, iocb={} Result={}", iocb->to_string(), iocb->result);
-                complete_io(iocb);
-            } else {
-                // ***** Paritial Read Handling ******** //
-                LOGDEBUGMOD(iomgr, "Received completion event with partial result, iocb={} size={} Result={}, retry={}",
-                            (void*)iocb, iocb->size, iocb->result, iocb->resubmit_cnt);
-                if (iocb->part_read_resubmit_cnt++ > IM_DYNAMIC_CONFIG(drive.partial_read_max_resubmit_cnt)) {
-                    LOGMSG_ASSERT(false, "Don't expect partial read to exceed retry limit={}",
-                                  IM_DYNAMIC_CONFIG(drive.partial_read_max_resubmit_cnt));
-                    // in production, keep retrying until we get all the data;
+            if (is_range_op(iocb) && !handle_range_completion(ch, iocb)) { continue; }
+
+            if (sisl_likely(iocb->result >= 0)) {
+                if (sisl_likely(is_range_op(iocb) || (static_cast< uint64_t >(iocb->result) == iocb->size))) {
+                    // all read buffer is filled by uring;
+                    LOGDEBUGMOD(iomgr, "Received completion event, iocb={} Result={}", iocb->to_string(),
+                                iocb->result);
+                    complete_io(ch, iocb);
+                } else {
+                    // ***** Paritial Read Handling ******** //
+                    LOGDEBUGMOD(iomgr,
+                                "Received completion event with partial result, iocb={} size={} Result={}, retry={}",
+                                (void*)iocb, iocb->size, iocb->result, iocb->resubmit_cnt);
+                    if (iocb->part_read_resubmit_cnt++ > IM_DYNAMIC_CONFIG(drive.partial_read_max_resubmit_cnt)) {
+                        LOGMSG_ASSERT(false, "Don't expect partial read to exceed retry limit={}",
+                                      IM_DYNAMIC_CONFIG(drive.partial_read_max_resubmit_cnt));
+                        // in production, keep retrying until we get all the data;
+                    }
+
+                    COUNTER_INCREMENT(m_metrics, retry_on_partial_read, 1);
+                    iocb->update_iovs_on_partial_result();
+                    // retry I/O with remaining unset data;
+                    ch->m_iocb_waitq.push(iocb);
+                    ch->dec_in_flight();
                 }
-
-                COUNTER_INCREMENT(m_metrics, retry_on_partial_read, 1);
-                iocb->update_iovs_on_partial_result();
-                // retry I/O with remaining unset data;
-                t_uring_ch->m_iocb_waitq.push(iocb);
-                --(t_uring_ch->m_in_flight_ios);
-            }
-        } else {
-            LOGERRORMOD(iomgr, "Error in completion of io, iocb={}, result={}, retry={}", (void*)iocb, iocb->result,
-                        iocb->resubmit_cnt);
-            if ((iocb->result != -EAGAIN) && iocb->resubmit_cnt++ > IM_DYNAMIC_CONFIG(drive.max_resubmit_cnt)) {
-                // EAGAIN won't increase resubmit_cnt;
-                DEBUG_ASSERT(false, "Don't expect op={} retry exceed limit={}", iocb->op_type,
-                             IM_DYNAMIC_CONFIG(drive.max_resubmit_cnt));
-                complete_io(iocb);
             } else {
-                // if disk driver return EAGAIN, keep retrying unconditionally;
-                // Retry IO by pushing it to waitq which will get scheduled later.
-                t_uring_ch->m_iocb_waitq.push(iocb);
+                LOGERRORMOD(iomgr, "Error in completion of io, iocb={}, result={}, retry={}", (void*)iocb,
+                            iocb->result, iocb->resubmit_cnt);
+                if ((iocb->result != -EAGAIN) && iocb->resubmit_cnt++ > IM_DYNAMIC_CONFIG(drive.max_resubmit_cnt)) {
+                    // EAGAIN won't increase resubmit_cnt;
+                    DEBUG_ASSERT(false, "Don't expect op={} retry exceed limit={}", iocb->op_type,
+                                 IM_DYNAMIC_CONFIG(drive.max_resubmit_cnt));
+                    complete_io(ch, iocb);
+                } else {
+                    // if disk driver return EAGAIN, keep retrying unconditionally;
+                    // Retry IO by pushing it to waitq which will get scheduled later.
+                    ch->m_iocb_waitq.push(iocb);
+                    ch->dec_in_flight();
+                }
             }
         }
-        t_uring_ch->drain_waitq();
-    } while (true);
+        ch->drain_waitq();
+    } while (count == cqes.size());
+}
+
+uint64_t UringDriveInterface::range_chunk_size(const drive_iocb* iocb) const {
+    return std::min(iocb->size,
+                    (iocb->op_type == DriveOpType::UNMAP) ? max_unmap_range_size(iocb->iodev)
+                                                          : max_zero_range_size(iocb->iodev));
 }
 
-void UringDriveInterface::complete_io(drive_iocb* iocb) {
-    --(t_uring_ch->m_in_flight_ios);
+bool UringDriveInterface::handle_range_completion(uring_drive_channel* ch, drive_iocb* iocb) {
+    if (iocb->result >= 0) {
+        const auto chunk = range_chunk_size(iocb);
+        iocb->offset += chunk;
+        iocb->size -= chunk;
+        if (iocb->size == 0) { return true; }
+
+        // Submit the next chunk of the range
+        ch->m_iocb_waitq.push(iocb);
+        ch->dec_in_flight();
+        return false;
+    }
+
+    if ((iocb->result == -EOPNOTSUPP) || (iocb->result == -EINVAL)) {
+        // Retrying won't help. Device or filesystem can't zero the range, but it can still be written with zeros.
+        if (iocb->op_type == DriveOpType::WRITE_ZERO) {
+            ch->dec_in_flight();
+            offload_io(
+                iocb,
+                [this](drive_iocb* iocb) -> int64_t {
+                    const auto err = sync_write_zero(iocb->iodev, iocb->size, iocb->offset);
+                    return err ? -err.value() : 0;
+                },
+                [this](drive_iocb* iocb) { finish_io(iocb); });
+            return false;
+        }
+        complete_io(ch, iocb);
+        return false;
+    }
+    return true;
+}
+
+bool UringDriveInterface::handle_durable_completion(uring_drive_channel* ch, drive_iocb* iocb, int32_t res,
+                                                    bool is_flush) {
+    if (!is_flush) {
+        // Write completion always comes before its linked flush, hold on to its result till the flush completes
+        iocb->result = res;
+        ch->dec_in_flight();
+        return false;
+    }
+
+    if ((iocb->result >= 0) && (static_cast< uint64_t >(iocb->result) != iocb->size)) {
+        // Flush is cancelled on short write. Retry the entire chain instead of resuming the write.
+        iocb->result = -EIO;
+    } else if ((iocb->result >= 0) && (res < 0)) {
+        iocb->result = res;
+    }
+    return true;
+}
+
+void UringDriveInterface::complete_io(uring_drive_channel* ch, drive_iocb* iocb) {
+    ch->dec_in_flight();
+    finish_io(iocb);
+}
 
+void UringDriveInterface::finish_io(drive_iocb* iocb) {
 #ifdef _PRERELEASE
-    if (DriveInterface::inject_delay_if_needed(iocb, [this](drive_iocb* iocb) { complete_io(iocb); })) { return; }
+    if (DriveInterface::inject_delay_if_needed(iocb, [this](drive_iocb* iocb) { finish_io(iocb); })) { return; }
 #endif
 
     if (sisl_likely(iocb->result >= 0)) {
-        static std::error_code success;
-        std::visit(overloaded{[&](folly::Promise< std::error_code >& p) { p.setValue(success); },
-                              [&](FiberManagerLib::Promise< std::error_code >& p) { p.setValue(success); },
-                              [&](io_interface_comp_cb_t& cb) { cb(iocb->result); }},
-                   iocb->completion);
+        iocb->complete(std::error_code{});
     } else {
-        std::visit(overloaded{[&](folly::Promise< std::error_code >& p) {
-                                  p.setValue(std::error_code{int_cast(-iocb->result), std::system_category()});
-                              },
-                              [&](FiberManagerLib::Promise< std::error_code >& p) {
-                                  p.setValue(std::error_code{int_cast(-iocb->result), std::system_category()});
-                              },
-                              [&](io_interface_comp_cb_t& cb) { cb(iocb->result); }},
-                   iocb->completion);
+        iocb->complete(std::error_code{int_cast(-iocb->result), std::system_category()});
     }
     DriveInterface::decrement_outstanding_counter(iocb);
-    delete iocb;
+    slab_delete(iocb);
 }
 } // namespace iomgr
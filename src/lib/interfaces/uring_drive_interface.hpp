@@ -20,15 +20,19 @@
 #include <queue>
 #include <atomic>
 #include <mutex>
+#include <shared_mutex>
 
 #include <fcntl.h>
 #include <liburing.h>
 #include <sys/eventfd.h>
 
+#include <folly/MPMCQueue.h>
 #include <sisl/metrics/metrics.hpp>
 #include <sisl/fds/buffer.hpp>
+#include <sisl/fds/id_reserver.hpp>
 
 #include "interfaces/kernel_drive_interface.hpp"
+#include "interfaces/uring_mempool.hpp"
 #include <iomgr/iomgr_types.hpp>
 
 namespace iomgr {
@@ -41,6 +45,8 @@ public:
         REGISTER_COUNTER(retry_on_partial_read, "number of times ios are retried on partial read");
         REGISTER_COUNTER(overflow_errors, "number of CQ overflow occurrences");
         REGISTER_COUNTER(num_of_drops, "number of dropped ios due to CQ overflow");
+        REGISTER_COUNTER(submit_ring_ios, "number of ios handed over to reactors through submit ring");
+        REGISTER_COUNTER(submit_ring_full, "number of ios sent as message because submit ring is full");
         register_me_to_farm();
     }
 
@@ -50,15 +56,33 @@ public:
 // Per thread structure which has all details for uring
 class UringDriveInterface;
 struct uring_drive_channel {
+    // Max completions reaped in one pass, before the waitq is drained
+    static constexpr uint32_t max_cqe_batch = 64;
+    // Tagged in the user data of the flush linked to a durable write, to tell its completion apart from the write
+    static constexpr uintptr_t linked_flush_tag = 0x1;
+
+    UringDriveInterface* m_iface;
     struct io_uring m_ring;
+    bool m_iopoll{false}; // Completions are polled from the device (IORING_SETUP_IOPOLL) instead of interrupts
+    bool m_sqpoll{false};
+    uint32_t m_cq_depth{0};
+    uint32_t m_last_overflow{0};
     std::queue< drive_iocb* > m_iocb_waitq;
     io_device_ptr m_ring_ev_iodev;
     // prepared_ios are IOs sent to uring but not submitted yet
     uint32_t m_prepared_ios{0};
     // in_flight_ios are IOs submitted to uring, but not completed yet
     uint32_t m_in_flight_ios{0};
-
-    uring_drive_channel(UringDriveInterface* iface);
+    // Registered buffers of this ring, nullptr if fixed buffers are not registered
+    const UringMemPool* m_fixed_bufs{nullptr};
+    // fd registered in each slot of the fixed file table of this ring, -1 if the slot is empty
+    std::vector< int > m_fixed_files;
+    // IOs handed over by threads outside of reactors, drained by the reactor in bulk. Only one wakeup is raised on the
+    // ring's eventfd until the reactor starts draining it.
+    std::unique_ptr< folly::MPMCQueue< drive_iocb* > > m_submit_q;
+    std::atomic< bool > m_wakeup_pending{false};
+
+    uring_drive_channel(UringDriveInterface* iface, bool iopoll);
     ~uring_drive_channel();
     drive_iocb* pop_waitq() {
         if (m_iocb_waitq.size() == 0) { return nullptr; }
@@ -70,16 +94,28 @@ struct uring_drive_channel {
     size_t waitq_size() const { return m_iocb_waitq.size(); }
     struct io_uring_sqe* get_sqe_or_enqueue(drive_iocb* iocb);
     void submit_ios();
-    // It assumes SQ size is same as CQ size, so we check the counters to make sure CQ doesn't overflow.
-    bool can_submit() const;
+    void dec_in_flight();
+    void poll_device();
+    // Checks the counters to make sure IOs in flight never exceed the CQ size, so that CQ doesn't overflow.
+    bool can_submit(uint32_t nsqes = 1) const;
+    // Durable write is submitted as a write linked with a datasync fsync, both generating their own completion
+    static uint32_t sqes_needed(const drive_iocb* iocb) { return iocb->durable ? 2 : 1; }
+    void check_overflow(UringDriveInterfaceMetrics& metrics);
     void submit_if_needed(drive_iocb* iocb, struct io_uring_sqe*, bool part_of_batch);
+    void prep_sqe_from_iocb(drive_iocb* iocb, struct io_uring_sqe* sqe);
+    void prep_linked_flush(drive_iocb* iocb, struct io_uring_sqe* write_sqe);
+    void set_fixed_file(IODevice* iodev, struct io_uring_sqe* sqe);
+    int fixed_file_slot(IODevice* iodev);
+    void unregister_fixed_file(int32_t slot);
     void drain_waitq();
+    // Called by any thread, returns false if the ring is full
+    bool queue_from_remote(drive_iocb* iocb);
 };
 
 class UringDriveInterface : public KernelDriveInterface {
-public:
-    static constexpr uint32_t per_thread_qdepth = 256;
+    friend struct uring_drive_channel;
 
+public:
     UringDriveInterface(const bool new_interface_supported, const io_interface_comp_cb_t& cb = nullptr);
     virtual ~UringDriveInterface() = default;
     drive_interface_type interface_type() const override { return drive_interface_type::uring; }
@@ -95,10 +131,22 @@ public:
                                                 bool part_of_batch = false) override;
     folly::Future< std::error_code > async_readv(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size,
                                                  uint64_t offset, bool part_of_batch = false) override;
+    void async_write_cb(IODevice* iodev, const char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                        bool part_of_batch = false) override;
+    void async_writev_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                         const drive_comp_cb& cb, bool part_of_batch = false) override;
+    void async_read_cb(IODevice* iodev, char* data, uint32_t size, uint64_t offset, const drive_comp_cb& cb,
+                       bool part_of_batch = false) override;
+    void async_readv_cb(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset,
+                        const drive_comp_cb& cb, bool part_of_batch = false) override;
     folly::Future< std::error_code > async_unmap(IODevice* iodev, uint32_t size, uint64_t offset,
                                                  bool part_of_batch = false) override;
     folly::Future< std::error_code > async_write_zero(IODevice* iodev, uint64_t size, uint64_t offset) override;
     folly::Future< std::error_code > queue_fsync(IODevice* iodev) override;
+    folly::Future< std::error_code > async_write_durable(IODevice* iodev, const char* data, uint32_t size,
+                                                         uint64_t offset) override;
+    folly::Future< std::error_code > async_writev_durable(IODevice* iodev, const iovec* iov, int iovcnt,
+                                                          uint32_t size, uint64_t offset) override;
 
     std::error_code sync_write(IODevice* iodev, const char* data, uint32_t size, uint64_t offset) override;
     std::error_code sync_writev(IODevice* iodev, const iovec* iov, int iovcnt, uint32_t size, uint64_t offset) override;
@@ -107,18 +155,55 @@ public:
 
     void on_event_notification(IODevice* iodev, void* cookie, int event);
     void handle_completions();
+    void async_submit(std::span< const drive_io_request > reqs) override;
     void submit_batch() override;
     DriveInterfaceMetrics& get_metrics() override { return m_metrics; }
+    const UringMemPool* fixed_bufs() const { return m_fixed_bufs.get(); }
 
 private:
     void init_iface_reactor_context(IOReactor*) override;
     void clear_iface_reactor_context(IOReactor*) override;
 
-    void complete_io(drive_iocb* iocb);
+    static uring_drive_channel* channel_for(const drive_iocb* iocb);
+    void submit_io(drive_iocb* iocb, bool part_of_batch);
+    void issue_io(drive_iocb* iocb, bool part_of_batch);
+    // Issues the batched reads/writes held for merging, with the contiguous ones merged
+    void flush_merge_q();
+    void submit_async_io(drive_iocb* iocb, bool part_of_batch);
+    void submit_qos_admitted(drive_iocb* iocb) override;
+    bool queue_to_reactor(drive_iocb* iocb);
+    void drain_submit_ring();
+    void register_submit_ring(uring_drive_channel* ch);
+    void unregister_submit_ring(uring_drive_channel* ch);
+    void handle_completions(uring_drive_channel* ch);
+    void complete_io(uring_drive_channel* ch, drive_iocb* iocb);
+    void finish_io(drive_iocb* iocb);
+
+    // Unmap and write zero are issued as fallocate on chunks of the range, one chunk in flight at a time
+    static bool is_range_op(const drive_iocb* iocb) {
+        return (iocb->op_type == DriveOpType::UNMAP) || (iocb->op_type == DriveOpType::WRITE_ZERO);
+    }
+    uint64_t range_chunk_size(const drive_iocb* iocb) const;
+    // Returns true if the range op is complete and the iocb has to be completed by caller
+    bool handle_range_completion(uring_drive_channel* ch, drive_iocb* iocb);
+    // Returns true once both the write and its linked flush are completed and iocb result is set for the chain
+    bool handle_durable_completion(uring_drive_channel* ch, drive_iocb* iocb, int32_t res, bool is_flush);
+    void release_fixed_file(IODevice* iodev);
+    bool fill_sqpoll_params(struct io_uring_params& params, bool attach);
+    void on_sqpoll_ring_created(int ring_fd);
+    void on_sqpoll_ring_destroyed(int ring_fd);
 
 private:
     static thread_local uring_drive_channel* t_uring_ch;
+    static thread_local uring_drive_channel* t_iopoll_ch;
     UringDriveInterfaceMetrics m_metrics;
     bool m_new_intfc;
+    bool m_fallocate_supported{false};
+    std::shared_ptr< UringMemPool > m_fixed_bufs;
+    sisl::IDReserver m_fixed_file_reserver;
+    std::mutex m_sqpoll_mtx;
+    int m_sqpoll_wq_fd{-1}; // Ring owning the shared kernel poller, which new rings attach to
+    std::shared_mutex m_submit_rings_mtx;
+    std::vector< uring_drive_channel* > m_submit_rings; // Channels of worker reactors accepting IOs from other threads
 };
 } // namespace iomgr
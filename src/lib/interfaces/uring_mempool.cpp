@@ -0,0 +1,144 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include <folly/Exception.h>
+#include <sisl/logging/logging.h>
+#include <sisl/fds/utils.hpp>
+#include "interfaces/uring_mempool.hpp"
+
+namespace iomgr {
+////////////////////////////// Uring Memory Allocator section ///////////////////////////////
+UringAlignedAllocImpl::UringAlignedAllocImpl(cshared< UringMemPool >& pool) : IOMgrAlignedAllocImpl(), m_pool{pool} {}
+
+uint8_t* UringAlignedAllocImpl::aligned_pool_alloc(const size_t align, const size_t sz, const sisl::buftag tag) {
+    auto buf = m_pool->alloc(align, sz);
+    if (buf == nullptr) { return IOMgrAlignedAllocImpl::aligned_pool_alloc(align, sz, tag); }
+#ifdef _PRERELEASE
+    sisl::AlignedAllocator::metrics().increment(tag, sz);
+#endif
+    return buf;
+}
+
+void UringAlignedAllocImpl::aligned_pool_free(uint8_t* const b, const size_t sz, const sisl::buftag tag) {
+    RELEASE_ASSERT_NOTNULL((void*)b, "buffer is null while freeing");
+    if (!m_pool->free(b)) {
+        IOMgrAlignedAllocImpl::aligned_pool_free(b, sz, tag);
+        return;
+    }
+#ifdef _PRERELEASE
+    sisl::AlignedAllocator::metrics().decrement(tag, sz);
+#endif
+}
+
+size_t UringAlignedAllocImpl::buf_size(uint8_t* buf) const {
+    const auto sz = m_pool->buf_size(buf);
+    return (sz != 0) ? sz : IOMgrAlignedAllocImpl::buf_size(buf);
+}
+
+////////////////////////////// Mempool section ///////////////////////////////
+UringMemPool::~UringMemPool() {
+    for (auto& r : m_regions) {
+        munmap(r.base, r.size);
+    }
+}
+
+void UringMemPool::create(size_t element_size, size_t element_count) {
+    RELEASE_ASSERT(((element_size & (element_size - 1)) == 0) && (element_size <= max_registered_iov_size),
+                   "Uring mempool element size={} has to be power of 2 and not exceeding 1GB", element_size);
+    RELEASE_ASSERT(std::none_of(m_regions.cbegin(), m_regions.cend(),
+                                [element_size](const region& r) { return r.elem_size == element_size; }),
+                   "Uring mempool for element size={} is already created", element_size);
+
+    region r;
+    r.elem_size = element_size;
+    const uint64_t page_size = sysconf(_SC_PAGESIZE);
+    r.size = ((element_size * element_count + page_size - 1) / page_size) * page_size;
+    r.base = (uint8_t*)mmap(nullptr, r.size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (r.base == MAP_FAILED) {
+        folly::throwSystemError(fmt::format("Unable to allocate uring mempool of size={}", r.size));
+    }
+
+    // mmap only guarantees page alignment of the base, so elements larger than a page are aligned only as much as the
+    // base happens to be. Since element size is power of 2, every element is aligned to the smaller of the two.
+    r.elem_align = std::min(uint64_t{element_size}, uint64_t{1} << __builtin_ctzll(r_cast< uint64_t >(r.base)));
+
+    r.free_q = std::make_unique< folly::MPMCQueue< uint8_t* > >(element_count);
+    for (size_t i{0}; i < element_count; ++i) {
+        r.free_q->blockingWrite(r.base + (i * element_size));
+    }
+
+    // Each region is split into iovecs which kernel accepts as a single registered buffer. Since element size is
+    // power of 2, no element straddles across the iovec boundary.
+    r.first_iov_idx = m_iovs.size();
+    for (uint64_t off{0}; off < r.size; off += max_registered_iov_size) {
+        m_iovs.push_back(iovec{r.base + off, std::min(max_registered_iov_size, r.size - off)});
+    }
+
+    LOGINFO("Created uring mempool of element count {} and size {}, registered iovecs={}", element_count,
+            element_size, m_iovs.size() - r.first_iov_idx);
+    m_regions.push_back(std::move(r));
+    std::sort(m_regions.begin(), m_regions.end(),
+              [](const region& a, const region& b) { return a.elem_size < b.elem_size; });
+}
+
+uint8_t* UringMemPool::alloc(size_t align, size_t size) {
+    for (auto& r : m_regions) {
+        if ((r.elem_size < size) || (r.elem_align % align != 0)) { continue; }
+
+        uint8_t* buf{nullptr};
+        if (r.free_q->read(buf)) {
+            COUNTER_INCREMENT(m_metrics, pool_alloc_hits, 1);
+            return buf;
+        }
+        // Bigger elements could still serve this size, but that would starve those sized IOs, so we fallback
+        break;
+    }
+    COUNTER_INCREMENT(m_metrics, pool_alloc_misses, 1);
+    return nullptr;
+}
+
+bool UringMemPool::free(uint8_t* buf) {
+    const auto r = region_of(buf);
+    if (r == nullptr) { return false; }
+    r->free_q->blockingWrite(buf);
+    return true;
+}
+
+size_t UringMemPool::buf_size(const uint8_t* buf) const {
+    const auto r = region_of(buf);
+    return (r == nullptr) ? 0 : r->elem_size;
+}
+
+int UringMemPool::fixed_buf_index(const void* buf, uint64_t size) const {
+    const auto b = r_cast< const uint8_t* >(buf);
+    const auto r = region_of(b);
+    if (r == nullptr) { return -1; }
+
+    const uint64_t off = b - r->base;
+    if ((off + size > r->size) || ((off / max_registered_iov_size) != ((off + size - 1) / max_registered_iov_size))) {
+        return -1;
+    }
+    return s_cast< int >(r->first_iov_idx + (off / max_registered_iov_size));
+}
+
+const UringMemPool::region* UringMemPool::region_of(const uint8_t* buf) const {
+    for (const auto& r : m_regions) {
+        if (r.contains(buf)) { return &r; }
+    }
+    return nullptr;
+}
+} // namespace iomgr
@@ -0,0 +1,94 @@
+/************************************************************************
+ * Modifications Copyright 2017-2019 eBay Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *    https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed
+ * under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+ * CONDITIONS OF ANY KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations under the License.
+ **************************************************************************/
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <sys/uio.h>
+
+#include <folly/MPMCQueue.h>
+#include <sisl/metrics/metrics.hpp>
+#include <sisl/fds/buffer.hpp>
+#include "epoll/epoll_mem.hpp"
+
+namespace iomgr {
+class UringMemPoolMetrics : public sisl::MetricsGroup {
+public:
+    explicit UringMemPoolMetrics() : sisl::MetricsGroup("UringMemPool", "UringMemPool") {
+        REGISTER_COUNTER(pool_alloc_hits, "Number of iobuf allocations served from registered buffers");
+        REGISTER_COUNTER(pool_alloc_misses, "Number of iobuf allocations which fell back to regular memory");
+        register_me_to_farm();
+    }
+
+    ~UringMemPoolMetrics() { deregister_me_from_farm(); }
+};
+
+// Memory pool whose regions are registered as fixed buffers on every uring ring. Each region serves equal sized
+// elements, similar to the spdk mempool, so that IO on these buffers can be issued as READ_FIXED/WRITE_FIXED and
+// avoid the per-IO page pinning in the kernel.
+class UringMemPool {
+public:
+    // Kernel does not allow a single registered buffer to be larger than 1GB, so regions are split into iovecs of
+    // this size while registering
+    static constexpr uint64_t max_registered_iov_size{1024ul * 1024ul * 1024ul};
+
+    UringMemPool() = default;
+    ~UringMemPool();
+    UringMemPool(const UringMemPool&) = delete;
+    UringMemPool& operator=(const UringMemPool&) = delete;
+
+    void create(size_t element_size, size_t element_count);
+
+    uint8_t* alloc(size_t align, size_t size);
+    bool free(uint8_t* buf);
+    size_t buf_size(const uint8_t* buf) const;
+
+    // Returns the registered buffer index if [buf, buf + size) is entirely within one registered iovec, else -1
+    int fixed_buf_index(const void* buf, uint64_t size) const;
+    const std::vector< iovec >& registered_iovs() const { return m_iovs; }
+    bool empty() const { return m_regions.empty(); }
+
+private:
+    struct region {
+        uint8_t* base{nullptr};
+        uint64_t size{0};
+        uint64_t elem_size{0};
+        uint64_t elem_align{0}; // Alignment every element of the region is guaranteed to have
+        uint32_t first_iov_idx{0};
+        std::unique_ptr< folly::MPMCQueue< uint8_t* > > free_q;
+
+        bool contains(const uint8_t* b) const { return (b >= base) && (b < base + size); }
+    };
+
+    const region* region_of(const uint8_t* buf) const;
+
+private:
+    std::vector< region > m_regions; // Sorted by element size
+    std::vector< iovec > m_iovs;
+    UringMemPoolMetrics m_metrics;
+};
+
+// Serves iobuf pool allocations from the uring mempool, rest of them and the fallbacks are served by iomanager's
+// regular allocator
+struct UringAlignedAllocImpl : public IOMgrAlignedAllocImpl {
+    UringAlignedAllocImpl(cshared< UringMemPool >& pool);
+    uint8_t* aligned_pool_alloc(const size_t align, const size_t sz, const sisl::buftag tag) override;
+    void aligned_pool_free(uint8_t* const b, const size_t sz, const sisl::buftag tag) override;
+    size_t buf_size(uint8_t* buf) const override;
+    cshared< UringMemPool >& pool() const { return m_pool; }
+
+private:
+    std::shared_ptr< UringMemPool > m_pool;
+};
+} // namespace iomgr
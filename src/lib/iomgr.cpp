@@ -123,12 +123,13 @@ void IOManager::start(const iomgr_params& params, const thread_state_notifier_t&
         m_impl = std::make_unique< IOManagerEpollImpl >();
     }
 
-    // Do Poller specific pre interface initialization
-    m_impl->pre_interface_init();
     bool new_interface_supported = false;
     m_is_uring_capable = check_uring_capability(new_interface_supported);
     LOGINFOMOD(iomgr, "System has uring_capability={}", m_is_uring_capable);
 
+    // Do Poller specific pre interface initialization
+    m_impl->pre_interface_init();
+
     // Create all in-built interfaces here
     set_state(iomgr_state::interface_init);
     m_default_general_iface = std::make_shared< GenericIOInterface >();
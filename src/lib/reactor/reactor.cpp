@@ -118,6 +118,9 @@ bool IOReactor::listen_once() {
         auto& sentinel_cb = iomanager.generic_interface()->get_listen_sentinel_cb();
         if (sentinel_cb) { sentinel_cb(); }
         if (m_iomgr_sentinel_cb) { m_iomgr_sentinel_cb(); }
+        for (const auto& cb : m_loop_end_cbs) {
+            if (cb) { cb(); }
+        }
 
         bool need_backoff{false};
         for (const auto& backoff_cb : m_can_backoff_cbs) {
@@ -286,6 +289,17 @@ void IOReactor::unregister_poll_interval_cb(const poll_cb_idx_t idx) {
     m_poll_interval_cbs[idx] = nullptr;
 }
 
+poll_cb_idx_t IOReactor::register_loop_end_cb(std::function< void(void) >&& cb) {
+    m_loop_end_cbs.emplace_back(std::move(cb));
+    return static_cast< poll_cb_idx_t >(m_loop_end_cbs.size() - 1);
+}
+
+void IOReactor::unregister_loop_end_cb(const poll_cb_idx_t idx) {
+    DEBUG_ASSERT(idx < m_loop_end_cbs.size(), "Invalid loop end cb idx {} to unregister", idx);
+    DEBUG_ASSERT(m_loop_end_cbs[idx] != nullptr, "Loop end cb idx {} already unregistered or never registered", idx);
+    m_loop_end_cbs[idx] = nullptr;
+}
+
 void IOReactor::add_backoff_cb(can_backoff_cb_t&& cb) { m_can_backoff_cbs.push_back(std::move(cb)); }
 
 void IOReactor::attach_iomgr_sentinel_cb(const listen_sentinel_cb_t& cb) { m_iomgr_sentinel_cb = cb; }
@@ -175,11 +175,21 @@ public:
     virtual const char* loop_type() const = 0;
 
     void set_poll_interval(const int interval) { m_poll_interval = interval; }
-    int get_poll_interval() const { return m_poll_interval; }
+    int get_poll_interval() const { return (m_tight_loop_holders != 0) ? 0 : m_poll_interval; }
+    // Runs the reactor in tight loop while there is any holder, regardless of the poll interval set. Used by the
+    // completions which are polled and never wakeup the reactor.
+    void hold_tight_loop() { ++m_tight_loop_holders; }
+    void release_tight_loop() {
+        DEBUG_ASSERT_GT(m_tight_loop_holders, 0u, "Releasing tight loop of reactor which was not held");
+        --m_tight_loop_holders;
+    }
     poll_cb_idx_t register_poll_interval_cb(std::function< void(void) >&& cb);
     void unregister_poll_interval_cb(const poll_cb_idx_t idx);
     IOThreadMetrics& thread_metrics() { return *(m_metrics.get()); }
     void add_backoff_cb(can_backoff_cb_t&& cb);
+    // Called at the end of every loop of the reactor, after all the events of the loop are processed
+    poll_cb_idx_t register_loop_end_cb(std::function< void(void) >&& cb);
+    void unregister_loop_end_cb(const poll_cb_idx_t idx);
     void attach_iomgr_sentinel_cb(const listen_sentinel_cb_t& cb);
     void detach_iomgr_sentinel_cb();
     virtual void handle_msg(iomgr_msg* msg);
@@ -220,11 +230,13 @@ protected:
     uint32_t m_n_iodevices = 0;
 
     int m_poll_interval{-1};
+    uint32_t m_tight_loop_holders{0};
     uint64_t m_total_op = 0;
 
     std::vector< std::unique_ptr< IOFiber > > m_io_fibers; // List of io threads within the reactor
     std::vector< std::function< void(void) > > m_poll_interval_cbs;
     std::vector< can_backoff_cb_t > m_can_backoff_cbs;
+    std::vector< std::function< void(void) > > m_loop_end_cbs;
     uint64_t m_cur_backoff_delay_us{0};
     uint64_t m_backoff_delay_min_us{0};
     listen_sentinel_cb_t m_iomgr_sentinel_cb;
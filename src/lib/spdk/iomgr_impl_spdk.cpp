@@ -113,6 +113,7 @@ void IOManagerSpdkImpl::pre_interface_init() {
             m_mempool->create(pool_entry->size, count);
         }
     }
+    if (IM_DYNAMIC_CONFIG(iomem.adaptive_pool_sizing)) { m_mempool->enable_adaptive_sizing(m_total_hugepage_size); }
 
     // Set the sisl::allocator with spdk allocator, so that all sisl libs start to use spdk for aligned allocations
     sisl::AlignedAllocator::instance().set_allocator(std::move(new SpdkAlignedAllocImpl(m_mempool)));
@@ -144,6 +145,15 @@ void IOManagerSpdkImpl::post_interface_init() {
         iomanager.wait_for_state(iomgr_state::running);
         // m_spdk_prepared = true;
     }
+
+    if (m_mempool->is_adaptive()) {
+        // Pools are grown by one worker alone, since creating a mempool stalls the reactor doing it
+        iomanager.run_on_wait(reactor_regex::random_worker, [this]() {
+            m_mempool_adapt_timer = iomanager.schedule_thread_timer(
+                IM_DYNAMIC_CONFIG(iomem.adaptive_pool_window_sec) * 1000ul * 1000ul * 1000ul, true, nullptr,
+                [this](void* cookie) { m_mempool->adapt_sizes(); });
+        });
+    }
 }
 
 bool IOManagerSpdkImpl::is_spdk_inited() const { return (m_spdk_prepared && !spdk_env_dpdk_external_init()); }
@@ -289,6 +299,10 @@ sys_thread_id_t IOManagerSpdkImpl::create_reactor_impl(const std::string& name,
 }
 
 void IOManagerSpdkImpl::pre_interface_stop() {
+    if (m_mempool_adapt_timer != null_timer_handle) {
+        iomanager.cancel_timer(m_mempool_adapt_timer, true);
+        m_mempool_adapt_timer = null_timer_handle;
+    }
     iomanager.run_on_forget(reactor_regex::least_busy_worker, []() {
         spdk_rpc_finish();
         spdk_subsystem_fini([](void* cb_arg) { iomanager.set_state_and_notify(iomgr_state::stopping); }, nullptr);
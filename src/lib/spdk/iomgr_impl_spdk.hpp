@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iomgr/iomgr_types.hpp>
+#include <iomgr/iomgr_timer.hpp>
 #include "iomgr_impl.hpp"
 #include "mempool_spdk.hpp"
 
@@ -24,6 +25,7 @@ private:
 private:
     shared< SpdkMemPool > m_mempool;
     uint64_t m_total_hugepage_size;
+    timer_handle_t m_mempool_adapt_timer{null_timer_handle};
     bool m_spdk_prepared{false};
     bool m_is_cpu_pinning_enabled{false};
     bool m_do_init_bdev{true};
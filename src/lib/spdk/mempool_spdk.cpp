@@ -1,4 +1,5 @@
 #include <iomgr/iomgr.hpp>
+#include "iomgr_config.hpp"
 #include "mempool_spdk.hpp"
 
 extern "C" {
@@ -38,7 +39,7 @@ uint8_t* SpdkAlignedAllocImpl::aligned_realloc(uint8_t* old_buf, size_t align, s
 }
 
 uint8_t* SpdkAlignedAllocImpl::aligned_pool_alloc(const size_t align, const size_t sz, const sisl::buftag tag) {
-    auto buf = static_cast< uint8_t* >(spdk_mempool_get(m_pool->get_mempool(sz)));
+    auto buf = static_cast< uint8_t* >(m_pool->alloc(sz));
 #ifdef _PRERELEASE
     if (buf) { sisl::AlignedAllocator::metrics().increment(tag, sz); }
 #endif
@@ -50,7 +51,7 @@ void SpdkAlignedAllocImpl::aligned_pool_free(uint8_t* const b, const size_t sz,
     sisl::AlignedAllocator::metrics().decrement(tag, sz);
 #endif
     RELEASE_ASSERT_NOTNULL((void*)b, "buffer is null while freeing");
-    spdk_mempool_put(m_pool->get_mempool(sz), b);
+    m_pool->free(b);
 }
 
 size_t SpdkAlignedAllocImpl::buf_size(uint8_t* buf) const {
@@ -61,10 +62,32 @@ size_t SpdkAlignedAllocImpl::buf_size(uint8_t* buf) const {
 }
 
 ////////////////////////////// Mempool section ///////////////////////////////
-SpdkMemPool::SpdkMemPool() {
-    for (size_t i{0}; i < max_mempool_count; ++i) {
-        m_internal_pools[i] = nullptr;
+SpdkMemPool::SpdkMemPool() = default;
+
+void SpdkMemPool::init_sockets() {
+    if (!m_socket_pools.empty()) { return; }
+
+    uint32_t core;
+    SPDK_ENV_FOREACH_CORE(core) {
+        const auto socket = spdk_env_get_socket_id(core);
+        if (socket >= m_socket_cores.size()) { m_socket_cores.resize(socket + 1, 0); }
+        ++m_socket_cores[socket];
+    }
+    if (m_socket_cores.empty()) { m_socket_cores.push_back(1); }
+    for (const auto n : m_socket_cores) {
+        m_total_cores += n;
     }
+
+    m_socket_pools = std::vector< pool_set_t >(m_socket_cores.size());
+    for (uint32_t s{0}; s < m_socket_cores.size(); ++s) {
+        m_socket_metrics.push_back(std::make_unique< SpdkMemPoolSocketMetrics >(s));
+    }
+}
+
+uint32_t SpdkMemPool::this_socket() const {
+    // Threads not pinned to a single socket get SOCKET_ID_ANY, which are served from the first socket
+    const auto socket = rte_socket_id();
+    return ((socket == unsigned(SOCKET_ID_ANY)) || (socket >= m_socket_pools.size())) ? 0 : socket;
 }
 
 void SpdkMemPool::register_metrics(struct rte_mempool* mp) {
@@ -82,30 +105,172 @@ void SpdkMemPool::metrics_populate() {
         (void*)this);
 }
 
-spdk_mempool* SpdkMemPool::get_mempool(size_t size) {
-    uint64_t idx = get_mempool_idx(size);
-    return m_internal_pools[idx];
-}
-
-void* SpdkMemPool::create(size_t element_size, size_t element_count) {
+void SpdkMemPool::create(size_t element_size, size_t element_count) {
+    init_sockets();
     const uint64_t idx = get_mempool_idx(element_size);
-    spdk_mempool* mempool = m_internal_pools[idx];
-    if (mempool != nullptr) {
-        if (spdk_mempool_count(mempool) == element_count) {
-            return mempool;
-        } else {
+    for (uint32_t s{0}; s < m_socket_pools.size(); ++s) {
+        auto& slot = m_socket_pools[s][idx][0];
+        auto mempool = slot.load(std::memory_order_relaxed);
+        if (mempool != nullptr) {
+            if (spdk_mempool_count(mempool) == socket_share(s, element_count)) { continue; }
+            slot.store(nullptr, std::memory_order_relaxed);
+            m_pool_bytes -= spdk_mempool_count(mempool) * element_size;
             spdk_mempool_free(mempool);
         }
     }
-    std::string name = "iomgr_mempool_" + std::to_string(element_size);
+    add_pools(idx, element_size, element_count, 0 /* gen */, true /* must_create */);
+}
+
+size_t SpdkMemPool::socket_share(uint32_t socket, size_t element_count) const {
+    return (m_socket_cores[socket] == 0) ? 0
+                                         : std::max(element_count * m_socket_cores[socket] / m_total_cores, size_t(1));
+}
+
+bool SpdkMemPool::add_pools(uint64_t idx, size_t element_size, size_t element_count, uint32_t gen,
+                            bool must_create) {
+    bool created{false};
+    for (uint32_t s{0}; s < m_socket_pools.size(); ++s) {
+        const size_t count = socket_share(s, element_count);
+        auto& slot = m_socket_pools[s][idx][gen];
+        if ((count == 0) || (slot.load(std::memory_order_relaxed) != nullptr)) { continue; }
+
+        // DPDK needs the pool to be at least 1.5 times the cache, which each core of this socket holds on to
+        const size_t max_cache_size =
+            std::min(count * 2 / (3 * m_socket_cores[s]), size_t(RTE_MEMPOOL_CACHE_MAX_SIZE));
+        const size_t cache_size = std::min(size_t(IM_DYNAMIC_CONFIG(iomem.mempool_cache_size)), max_cache_size);
+        std::string name = "iomgr_mempool_" + std::to_string(element_size) + "_s" + std::to_string(s);
+        if (gen != 0) { name += "_g" + std::to_string(gen); }
+        LOGINFO("Creating new mempool {} of element count {} size {} cache_size {} on socket {}", name, count,
+                element_size, cache_size, s);
+        auto mempool = spdk_mempool_create(name.c_str(), count, element_size, cache_size, s);
+        if (mempool == nullptr) {
+            // Socket doesn't have enough hugepages of its own, take it from anywhere
+            LOGWARN("Unable to create mempool {} on socket {}, rte_errno={} {}, creating on any socket", name, s,
+                    rte_errno, rte_strerror(rte_errno));
+            mempool = spdk_mempool_create(name.c_str(), count, element_size, cache_size, SPDK_ENV_SOCKET_ID_ANY);
+        }
+        if (must_create) {
+            RELEASE_ASSERT(mempool != nullptr, "Failed to create new mempool of size={}, rte_errno={} {}",
+                           element_size, rte_errno, rte_strerror(rte_errno));
+        } else if (mempool == nullptr) {
+            // Growing is best effort, allocations continue to fallback for this size
+            LOGWARN("Unable to grow mempool {}, rte_errno={} {}", name, rte_errno, rte_strerror(rte_errno));
+            continue;
+        }
+
+        register_metrics(r_cast< rte_mempool* >(mempool));
+        m_pool_bytes += count * element_size;
+        slot.store(mempool, std::memory_order_release);
+        created = true;
+    }
+    return created;
+}
+
+void* SpdkMemPool::get_from_socket(uint32_t socket, uint64_t idx) {
+    for (auto& slot : m_socket_pools[socket][idx]) {
+        auto mp = slot.load(std::memory_order_acquire);
+        if (mp == nullptr) { break; }
+        if (auto buf = spdk_mempool_get(mp); buf != nullptr) { return buf; }
+    }
+    return nullptr;
+}
+
+void* SpdkMemPool::alloc(size_t size) {
+    if (m_socket_pools.empty()) { return nullptr; }
+    const uint64_t idx = get_mempool_idx(size);
+    const uint32_t socket = this_socket();
+    if (m_adaptive) { m_class_stats[idx].allocs.fetch_add(1, std::memory_order_relaxed); }
+
+    if (auto buf = get_from_socket(socket, idx); buf != nullptr) {
+        COUNTER_INCREMENT(*m_socket_metrics[socket], pool_alloc_hits, 1);
+        return buf;
+    }
+
+    // Remote socket memory is still better than falling back to spdk_malloc
+    for (uint32_t s{0}; s < m_socket_pools.size(); ++s) {
+        if (s == socket) { continue; }
+        if (auto buf = get_from_socket(s, idx); buf != nullptr) {
+            COUNTER_INCREMENT(*m_socket_metrics[socket], pool_alloc_remote, 1);
+            return buf;
+        }
+    }
+    COUNTER_INCREMENT(*m_socket_metrics[socket], pool_alloc_misses, 1);
+    if (m_adaptive) { m_class_stats[idx].misses.fetch_add(1, std::memory_order_relaxed); }
+    return nullptr;
+}
 
-    LOGINFO("Creating new mempool {} of element count {} and size {}", name, element_count, element_size);
-    mempool = spdk_mempool_create(name.c_str(), element_count, element_size, 0, SPDK_ENV_SOCKET_ID_ANY);
-    RELEASE_ASSERT(mempool != nullptr, "Failed to create new mempool of size={}, rte_errno={} {}", element_size,
-                   rte_errno, rte_strerror(rte_errno));
-    m_internal_pools[idx] = mempool;
-    register_metrics(r_cast< rte_mempool* >(mempool));
-    return mempool;
+void SpdkMemPool::free(void* buf) {
+    // Buffer goes back to the pool it came from, which need not be the pool of the freeing thread's socket
+    spdk_mempool_put(r_cast< spdk_mempool* >(rte_mempool_from_obj(buf)), buf);
+}
+
+void SpdkMemPool::enable_adaptive_sizing(uint64_t hugepage_size) {
+    init_sockets();
+    m_pool_budget = hugepage_size * std::min(IM_DYNAMIC_CONFIG(iomem.adaptive_pool_max_percent), 100u) / 100;
+    m_adaptive = true;
+    LOGINFO("Adaptive mempool sizing enabled, pools can grow upto {} bytes, currently {} bytes", m_pool_budget,
+            m_pool_bytes);
+}
+
+void SpdkMemPool::adapt_sizes() {
+    // Every size which fell back in this window grows by the number of misses, atleast by a quarter of what it has.
+    // Sizes which allocated the most bytes from fallback are grown first, as long as the budget permits.
+    struct grow_req {
+        uint64_t idx;
+        size_t count;
+    };
+    std::vector< grow_req > reqs;
+    for (uint64_t idx{0}; idx < max_mempool_count; ++idx) {
+        const auto allocs = m_class_stats[idx].allocs.exchange(0, std::memory_order_relaxed);
+        const auto misses = m_class_stats[idx].misses.exchange(0, std::memory_order_relaxed);
+        if (misses == 0) { continue; }
+
+        size_t cur_count{0};
+        for (auto& pools : m_socket_pools) {
+            for (auto& slot : pools[idx]) {
+                if (auto mp = slot.load(std::memory_order_relaxed); mp != nullptr) {
+                    cur_count += spdk_mempool_count(mp) + rte_mempool_in_use_count(r_cast< rte_mempool* >(mp));
+                }
+            }
+        }
+        LOGINFO("Mempool of size={} had allocs={} misses={} in the last window, current count={}",
+                min_mempool_buf_size << idx, allocs, misses, cur_count);
+        reqs.push_back(grow_req{idx, std::max(size_t(misses), cur_count / 4)});
+    }
+    std::sort(reqs.begin(), reqs.end(), [](const grow_req& a, const grow_req& b) {
+        return ((a.count << a.idx) > (b.count << b.idx));
+    });
+
+    for (const auto& req : reqs) {
+        const size_t element_size = min_mempool_buf_size << req.idx;
+        if (m_pool_bytes >= m_pool_budget) { break; }
+        const size_t count = std::min(req.count, (m_pool_budget - m_pool_bytes) / element_size);
+        if (count == 0) { continue; }
+
+        const auto gen = next_gen(req.idx);
+        if (gen == max_pool_gens) {
+            LOGDEBUGMOD(iomgr, "Mempool of size={} can't grow anymore, all its generations are used", element_size);
+            continue;
+        }
+        if (add_pools(req.idx, element_size, count, gen, false /* must_create */)) {
+            COUNTER_INCREMENT(m_adapt_metrics, adaptive_pool_grows, 1);
+            LOGINFO("Grown mempool of size={} by count={}, total pool bytes={}", element_size, count, m_pool_bytes);
+        }
+    }
+    GAUGE_UPDATE(m_adapt_metrics, adaptive_pool_bytes, m_pool_bytes);
+}
+
+uint32_t SpdkMemPool::next_gen(uint64_t idx) const {
+    // All sockets grow together, so the first socket which has pools tells the next free generation
+    for (uint32_t s{0}; s < m_socket_pools.size(); ++s) {
+        if (m_socket_cores[s] == 0) { continue; }
+        uint32_t gen{0};
+        while ((gen < max_pool_gens) && (m_socket_pools[s][idx][gen].load(std::memory_order_relaxed) != nullptr)) {
+            ++gen;
+        }
+        return gen;
+    }
+    return max_pool_gens;
 }
 
 uint64_t SpdkMemPool::get_mempool_idx(size_t size) const {
@@ -116,10 +281,14 @@ uint64_t SpdkMemPool::get_mempool_idx(size_t size) const {
 }
 
 void SpdkMemPool::reset() {
-    for (spdk_mempool* mempool : m_internal_pools) {
-        if (mempool != nullptr) { spdk_mempool_free(mempool); }
+    for (auto& pools : m_socket_pools) {
+        for (auto& gens : pools) {
+            for (auto& slot : gens) {
+                if (auto mp = slot.exchange(nullptr); mp != nullptr) { spdk_mempool_free(mp); }
+            }
+        }
     }
-    m_internal_pools.fill(nullptr);
+    m_pool_bytes = 0;
 }
 
 IOMempoolMetrics::IOMempoolMetrics(const std::string& pool_name, const struct spdk_mempool* mp) :
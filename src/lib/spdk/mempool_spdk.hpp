@@ -1,7 +1,11 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include <vector>
 
 #include <sisl/metrics/metrics.hpp>
 #include <sisl/fds/bitword.hpp>
@@ -26,26 +30,89 @@ private:
     const struct spdk_mempool* m_mp;
 };
 
+class SpdkMemPoolSocketMetrics : public sisl::MetricsGroup {
+public:
+    explicit SpdkMemPoolSocketMetrics(uint32_t socket) :
+            sisl::MetricsGroup("SpdkMemPoolSocket", "socket_" + std::to_string(socket)) {
+        REGISTER_COUNTER(pool_alloc_hits, "Number of iobuf allocations served from pool of this socket");
+        REGISTER_COUNTER(pool_alloc_remote, "Number of iobuf allocations served from pool of other socket");
+        REGISTER_COUNTER(pool_alloc_misses, "Number of iobuf allocations which fell back to regular spdk memory");
+        register_me_to_farm();
+    }
+
+    ~SpdkMemPoolSocketMetrics() { deregister_me_from_farm(); }
+};
+
+class SpdkMemPoolAdaptMetrics : public sisl::MetricsGroup {
+public:
+    SpdkMemPoolAdaptMetrics() : sisl::MetricsGroup("SpdkMemPoolAdapt", "SpdkMemPoolAdapt") {
+        REGISTER_COUNTER(adaptive_pool_grows, "Number of times a mempool size is grown by adaptive sizing");
+        REGISTER_GAUGE(adaptive_pool_bytes, "Total bytes of hugepage memory carved into mempools");
+        register_me_to_farm();
+    }
+
+    ~SpdkMemPoolAdaptMetrics() { deregister_me_from_farm(); }
+};
+
 static constexpr uint64_t max_mempool_buf_size{256 * 1024};
 static constexpr uint64_t min_mempool_buf_size{512};
 static constexpr uint64_t max_mempool_count{sisl::logBase2(max_mempool_buf_size - min_mempool_buf_size)};
 
+// Set of spdk mempools of power of 2 element sizes, created on each NUMA socket which has spdk cores. Allocations are
+// served from the pool of the caller's socket, so that DMA buffers are local to the reactor issuing the IO.
+//
+// With adaptive sizing, every size keeps count of allocations which had to fallback to spdk_malloc and periodically
+// the sizes are grown by adding one more generation of pools, bounded by a share of the hugepage memory. Pools are
+// never shrunk, since their buffers can be outstanding anytime.
 class SpdkMemPool {
 public:
     SpdkMemPool();
     void register_metrics(struct ::rte_mempool* mp);
     void metrics_populate();
-    spdk_mempool* get_mempool(size_t size);
-    void* create(size_t element_size, size_t element_count);
+    // Total element_count is split across sockets in proportion to their spdk cores
+    void create(size_t element_size, size_t element_count);
+    void* alloc(size_t size);
+    void free(void* buf);
     void reset();
 
+    // Starts recording allocation misses per size, pools could grow upto the configured percent of hugepage_size
+    void enable_adaptive_sizing(uint64_t hugepage_size);
+    bool is_adaptive() const { return m_adaptive; }
+    // Grows the pools based on the misses seen since the last call, called periodically from the timer of one worker
+    void adapt_sizes();
+
 private:
+    static constexpr uint32_t max_pool_gens{4};
+
     uint64_t get_mempool_idx(size_t size) const;
+    void init_sockets();
+    uint32_t this_socket() const;
+    size_t socket_share(uint32_t socket, size_t element_count) const;
+    bool add_pools(uint64_t idx, size_t element_size, size_t element_count, uint32_t gen, bool must_create);
+    void* get_from_socket(uint32_t socket, uint64_t idx);
+    uint32_t next_gen(uint64_t idx) const;
 
 private:
-    std::array< spdk_mempool*, max_mempool_count > m_internal_pools;
+    struct class_stats {
+        std::atomic< uint64_t > allocs{0};
+        std::atomic< uint64_t > misses{0};
+    };
+
+    // Each size has upto max_pool_gens pools per socket, generation 0 is created upfront and rest by adaptive sizing
+    using pool_gens_t = std::array< std::atomic< spdk_mempool* >, max_pool_gens >;
+    using pool_set_t = std::array< pool_gens_t, max_mempool_count >;
+    std::vector< pool_set_t > m_socket_pools; // Indexed by socket id
+    std::vector< uint32_t > m_socket_cores;   // Number of spdk cores on each socket
+    uint32_t m_total_cores{0};
+    std::vector< std::unique_ptr< SpdkMemPoolSocketMetrics > > m_socket_metrics;
     std::mutex m_mset_mtx;
     std::unordered_map< std::string, IOMempoolMetrics > m_mempool_metrics_set;
+
+    bool m_adaptive{false};
+    uint64_t m_pool_budget{0};
+    std::atomic< uint64_t > m_pool_bytes{0};
+    std::array< class_stats, max_mempool_count > m_class_stats;
+    SpdkMemPoolAdaptMetrics m_adapt_metrics;
 };
 
 struct SpdkAlignedAllocImpl : public sisl::AlignedAllocatorImpl {
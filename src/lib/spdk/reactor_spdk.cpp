@@ -12,7 +12,11 @@
  * CONDITIONS OF ANY KIND, either express or implied. See the License for the
  * specific language governing permissions and limitations under the License.
  **************************************************************************/
+#include <algorithm>
 #include <cstring>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #include <sisl/logging/logging.h>
 #include <sisl/fds/obj_allocator.hpp>
@@ -24,6 +28,7 @@
 #include <iomgr/iomgr.hpp>
 #include <iomgr/iomgr_msg.hpp>
 #include "reactor_spdk.hpp"
+#include "iomgr_config.hpp"
 
 namespace iomgr {
 static std::string s_spdk_thread_name_prefix = "iomgr_reactor_io_thread_";
@@ -43,7 +48,9 @@ int IOReactorSPDK::event_about_spdk_thread(struct spdk_thread* sthread, enum spd
         // Since we get a callback for even the thread this reactor created, we check for this and return rightaway.
         if (is_iomgr_created_spdk_thread(sthread)) { return 0; }
 
-        auto reactor = static_cast< IOReactorSPDK* >(iomanager.round_robin_reactor());
+        auto reactor = least_loaded_reactor(sthread, nullptr);
+        if (reactor == nullptr) { reactor = static_cast< IOReactorSPDK* >(iomanager.round_robin_reactor()); }
+        reactor->m_num_external.fetch_add(1, std::memory_order_relaxed);
         iomanager.run_on_forget(
             reactor->pick_fiber(fiber_regex::main_only),
             [](void* arg) {
@@ -53,7 +60,20 @@ int IOReactorSPDK::event_about_spdk_thread(struct spdk_thread* sthread, enum spd
             (void*)sthread);
         return 0;
     }
-    case spdk_thread_op::SPDK_THREAD_OP_RESCHED:
+    case spdk_thread_op::SPDK_THREAD_OP_RESCHED: {
+        // Threads created by iomgr are tied to their fibers, only external threads can move. Resched is called on the
+        // reactor polling the thread, with its new cpumask already set.
+        if (is_iomgr_created_spdk_thread(sthread)) { return -ENOTSUP; }
+
+        auto cur_reactor = static_cast< IOReactorSPDK* >(iomanager.this_reactor());
+        auto reactor = least_loaded_reactor(sthread, nullptr);
+        if ((reactor == nullptr) || !reactor->can_run(sthread)) { return -ENOTSUP; }
+        if (reactor != cur_reactor) {
+            reactor->m_num_external.fetch_add(1, std::memory_order_relaxed);
+            cur_reactor->m_pending_migrations.emplace_back(sthread, reactor);
+        }
+        return 0;
+    }
     default:
         return -ENOTSUP;
     }
@@ -62,13 +82,40 @@ int IOReactorSPDK::event_about_spdk_thread(struct spdk_thread* sthread, enum spd
 bool IOReactorSPDK::reactor_thread_op_supported(enum spdk_thread_op op) {
     switch (op) {
     case SPDK_THREAD_OP_NEW:
-        return true;
     case SPDK_THREAD_OP_RESCHED:
+        return true;
     default:
         return false;
     }
 }
 
+bool IOReactorSPDK::can_run(spdk_thread* sthread) const {
+    return (m_lcore == std::numeric_limits< uint32_t >::max()) ||
+        spdk_cpuset_get_cpu(spdk_thread_get_cpumask(sthread), m_lcore);
+}
+
+IOReactorSPDK* IOReactorSPDK::least_loaded_reactor(spdk_thread* sthread, const IOReactorSPDK* exclude) {
+    // Reactors on the cores allowed by thread's cpumask are preferred, but if none, thread is still placed somewhere
+    IOReactorSPDK* best{nullptr};
+    bool best_can_run{false};
+    for (const auto& r : iomanager.m_worker_reactors) {
+        auto reactor = dynamic_cast< IOReactorSPDK* >(r.get());
+        if ((reactor == nullptr) || (reactor == exclude)) { continue; }
+
+        const bool can_run = reactor->can_run(sthread);
+        // Among equally loaded reactors, ones with fewer external threads are picked, so that threads created
+        // before any load is sampled are spread out
+        const auto load = std::make_pair(reactor->load_pct(), reactor->m_num_external.load(std::memory_order_relaxed));
+        if ((best == nullptr) || (can_run && !best_can_run) ||
+            ((can_run == best_can_run) &&
+             (load < std::make_pair(best->load_pct(), best->m_num_external.load(std::memory_order_relaxed))))) {
+            best = reactor;
+            best_can_run = can_run;
+        }
+    }
+    return best;
+}
+
 std::string IOReactorSPDK::gen_spdk_thread_name() {
     static uint32_t s_sthread_idx{0};
     return s_spdk_thread_name_prefix + std::to_string(s_sthread_idx++);
@@ -100,16 +147,158 @@ void IOReactorSPDK::init_impl() {
         fiber->spdk_thr = sthread;
     }
     m_thread_timer = std::make_unique< timer_spdk >(m_io_fibers[0].get());
+
+    m_lcore = spdk_env_get_current_core();
+    m_last_sample_tsc = spdk_get_ticks();
+
+    m_idle_sleep_after_us = IM_DYNAMIC_CONFIG(poll.spdk_idle_sleep_after_us);
+    if (m_idle_sleep_after_us != 0) {
+        m_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_wakeup_fd == -1) { throw std::system_error(errno, std::generic_category(), "SPDK reactor eventfd"); }
+        m_last_busy_time = Clock::now();
+    }
 }
 
 void IOReactorSPDK::listen() {
+    const bool busy = poll_spdk_threads();
+    if (!m_pending_migrations.empty()) { migrate_spdk_threads(); }
+
+    const uint64_t sample_ticks = IM_DYNAMIC_CONFIG(poll.spdk_thread_stats_interval_ms) * spdk_get_ticks_hz() / 1000;
+    if ((spdk_get_ticks() - m_last_sample_tsc) >= sample_ticks) { sample_thread_loads(); }
+
+    if (m_wakeup_fd != -1) { sleep_if_idle(busy); }
+}
+
+void IOReactorSPDK::sample_thread_loads() {
+    const uint64_t now = spdk_get_ticks();
+    const uint64_t elapsed = now - m_last_sample_tsc;
+    if (elapsed == 0) { return; }
+    m_last_sample_tsc = now;
+
+    uint64_t total_busy{0};
+    spdk_thread* hottest{nullptr};
+    uint32_t hottest_pct{0};
+    auto orig_thread = spdk_get_thread();
+    const auto sample = [&](spdk_thread* sthread, bool is_external) {
+        // Stats are available only for the current spdk thread
+        spdk_set_thread(sthread);
+        spdk_thread_stats stats;
+        if (spdk_thread_get_stats(&stats) != 0) { return; }
+
+        auto& load = m_thread_loads[sthread];
+        const uint64_t busy = stats.busy_tsc - load.busy_tsc;
+        load.busy_tsc = stats.busy_tsc;
+        load.load_pct = s_cast< uint32_t >(std::min(busy * 100 / elapsed, 100ul));
+        total_busy += busy;
+        if (is_external && (load.load_pct > hottest_pct)) {
+            hottest = sthread;
+            hottest_pct = load.load_pct;
+        }
+    };
+    for (auto& fiber : m_io_fibers) {
+        sample(fiber->spdk_thr, false /* is_external */);
+    }
+    for (auto& thr : m_external_spdk_threads) {
+        sample(thr, true /* is_external */);
+    }
+    spdk_set_thread(orig_thread);
+
+    const uint32_t my_load = s_cast< uint32_t >(std::min(total_busy * 100 / elapsed, 100ul));
+    m_load_pct.store(my_load, std::memory_order_relaxed);
+
+    // Move the busiest external thread only if it doesn't just make the other reactor the hot one
+    const uint32_t rebalance_pct = IM_DYNAMIC_CONFIG(poll.spdk_thread_rebalance_pct);
+    if ((rebalance_pct == 0) || (hottest == nullptr)) { return; }
+    auto target = least_loaded_reactor(hottest, this);
+    if ((target == nullptr) || !target->can_run(hottest)) { return; }
+
+    const uint32_t target_load = target->load_pct();
+    if ((my_load > target_load) && ((my_load - target_load) > rebalance_pct) &&
+        (hottest_pct < (my_load - target_load))) {
+        target->m_num_external.fetch_add(1, std::memory_order_relaxed);
+        m_pending_migrations.emplace_back(hottest, target);
+    }
+}
+
+void IOReactorSPDK::migrate_spdk_threads() {
+    auto migrations = std::move(m_pending_migrations);
+    m_pending_migrations.clear();
+    for (const auto& [sthread, to] : migrations) {
+        if (std::erase(m_external_spdk_threads, sthread) == 0) {
+            to->m_num_external.fetch_sub(1, std::memory_order_relaxed);
+            continue;
+        }
+        m_num_external.fetch_sub(1, std::memory_order_relaxed);
+        m_thread_loads.erase(sthread);
+        REACTOR_LOG(INFO, , , "Moving External SPDK Thread {} to reactor={} with load={}%, this reactor load={}%",
+                    spdk_thread_get_name(sthread), to->reactor_idx(), to->load_pct(), load_pct());
+        iomanager.run_on_forget(
+            to->pick_fiber(fiber_regex::main_only),
+            [](void* arg) {
+                auto sthread = reinterpret_cast< spdk_thread* >(arg);
+                static_cast< IOReactorSPDK* >(iomanager.this_reactor())->add_external_spdk_thread(sthread);
+            },
+            (void*)sthread);
+    }
+}
+
+bool IOReactorSPDK::poll_spdk_threads() {
+    bool busy{false};
     for (auto& fiber : m_io_fibers) {
         if (!m_keep_running) { break; }
-        spdk_thread_poll(fiber->spdk_thr, 0, 0);
+        if (spdk_thread_poll(fiber->spdk_thr, 0, 0) > 0) { busy = true; }
     }
 
     for (auto& thr : m_external_spdk_threads) {
-        spdk_thread_poll(thr, 0, 0);
+        if (spdk_thread_poll(thr, 0, 0) > 0) { busy = true; }
+    }
+    return busy;
+}
+
+void IOReactorSPDK::sleep_if_idle(bool busy) {
+    if (busy || (m_metrics->outstanding_ops != 0) || !m_keep_running) {
+        m_last_busy_time = Clock::now();
+        return;
+    }
+    if (get_elapsed_time_us(m_last_busy_time) < m_idle_sleep_after_us) { return; }
+
+    // Sleep no longer than the nearest timed poller across all the spdk threads of this reactor
+    uint64_t sleep_us = IM_DYNAMIC_CONFIG(poll.spdk_idle_sleep_max_us);
+    const uint64_t now_ticks = spdk_get_ticks();
+    const auto clip_to_poller = [&sleep_us, now_ticks](spdk_thread* thr) {
+        const uint64_t expiry = spdk_thread_next_poller_expiration(thr);
+        if (expiry == 0) { return; }
+        const uint64_t us = (expiry > now_ticks) ? ((expiry - now_ticks) * 1000000ul / spdk_get_ticks_hz()) : 0;
+        sleep_us = std::min(sleep_us, us);
+    };
+    for (auto& fiber : m_io_fibers) {
+        clip_to_poller(fiber->spdk_thr);
+    }
+    for (auto& thr : m_external_spdk_threads) {
+        clip_to_poller(thr);
+    }
+    if (sleep_us == 0) { return; }
+
+    // Pairs with the fence in put_msg, message sent before it could see the flag is picked by this poll
+    m_sleeping.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (poll_spdk_threads()) {
+        m_sleeping.store(false, std::memory_order_relaxed);
+        m_last_busy_time = Clock::now();
+        return;
+    }
+
+    pollfd pfd{m_wakeup_fd, POLLIN, 0};
+    const timespec ts{s_cast< time_t >(sleep_us / 1000000ul), s_cast< long >((sleep_us % 1000000ul) * 1000ul)};
+    const int ret = ppoll(&pfd, 1, &ts, nullptr);
+    m_sleeping.store(false, std::memory_order_relaxed);
+
+    if (ret > 0) {
+        uint64_t count;
+        [[maybe_unused]] const auto r = read(m_wakeup_fd, &count, sizeof(count));
+        ++m_metrics->msg_event_wakeup_count;
+    } else {
+        ++m_metrics->idle_wakeup_count;
     }
 }
 
@@ -123,6 +312,11 @@ void IOReactorSPDK::stop_impl() {
         spdk_thread_destroy(fiber->spdk_thr);
         fiber->spdk_thr = nullptr;
     }
+
+    if (m_wakeup_fd != -1) {
+        close(m_wakeup_fd);
+        m_wakeup_fd = -1;
+    }
 }
 
 void IOReactorSPDK::add_external_spdk_thread(struct spdk_thread* sthread) {
@@ -142,6 +336,13 @@ int IOReactorSPDK::remove_iodev_impl(const io_device_ptr& iodev) {
 
 void IOReactorSPDK::put_msg(iomgr_msg* msg) {
     spdk_thread_send_msg(msg->m_dest_fiber->spdk_thr, _handle_thread_msg, msg);
+    if (m_wakeup_fd != -1) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_sleeping.load(std::memory_order_relaxed)) {
+            const uint64_t one{1};
+            [[maybe_unused]] const auto r = write(m_wakeup_fd, &one, sizeof(one));
+        }
+    }
 }
 
 bool IOReactorSPDK::is_iodev_addable(const io_device_const_ptr& iodev) const {
@@ -13,6 +13,12 @@
  * specific language governing permissions and limitations under the License.
  **************************************************************************/
 #pragma once
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "reactor/reactor.hpp"
 #include <iomgr/io_interface.hpp>
 #include <spdk/thread.h>
@@ -34,12 +40,21 @@ public:
     static bool is_iomgr_created_spdk_thread(const spdk_thread* thread);
     static spdk_thread* create_spdk_thread();
 
+    // Percentage of time spdk threads of this reactor were busy, as of last sample
+    uint32_t load_pct() const { return m_load_pct.load(std::memory_order_relaxed); }
+
 private:
     const char* loop_type() const override { return "SPDK"; }
     void init_impl() override;
     void stop_impl() override;
     void add_external_spdk_thread(struct spdk_thread* sthread);
     void listen() override;
+    bool poll_spdk_threads();
+    void sleep_if_idle(bool busy);
+    void sample_thread_loads();
+    void migrate_spdk_threads();
+    bool can_run(spdk_thread* sthread) const;
+    static IOReactorSPDK* least_loaded_reactor(spdk_thread* sthread, const IOReactorSPDK* exclude);
     int add_iodev_impl(const io_device_ptr& iodev) override;
     int remove_iodev_impl(const io_device_ptr& iodev) override;
     void put_msg(iomgr_msg* msg) override;
@@ -47,5 +62,23 @@ private:
 
 private:
     std::vector< spdk_thread* > m_external_spdk_threads;
+
+    // Idle sleep, enabled only if spdk_idle_sleep_after_us is set
+    int m_wakeup_fd{-1};
+    std::atomic< bool > m_sleeping{false};
+    uint64_t m_idle_sleep_after_us{0};
+    Clock::time_point m_last_busy_time;
+
+    // Load tracking of the spdk threads, to place and move the external spdk threads across reactors
+    struct sthread_load {
+        uint64_t busy_tsc{0};
+        uint32_t load_pct{0};
+    };
+    uint32_t m_lcore{std::numeric_limits< uint32_t >::max()};
+    std::atomic< uint32_t > m_load_pct{0};
+    std::atomic< uint32_t > m_num_external{0}; // External threads on or on the way to this reactor
+    uint64_t m_last_sample_tsc{0};
+    std::unordered_map< spdk_thread*, sthread_load > m_thread_loads;
+    std::vector< std::pair< spdk_thread*, IOReactorSPDK* > > m_pending_migrations;
 };
 } // namespace iomgr
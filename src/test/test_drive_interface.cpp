@@ -1,16 +1,21 @@
 /*
  * Copyright 2018 by eBay Corporation
  */
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
+#include <functional>
 #include <mutex>
 #include <random>
+#include <span>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 #include <sisl/logging/logging.h>
@@ -24,6 +29,13 @@
 #include <iomgr/iomgr.hpp>
 #include <iomgr/io_environment.hpp>
 #include <iomgr/drive_interface.hpp>
+#include <iomgr/block_cache.hpp>
+#include "interfaces/aio_drive_interface.hpp"
+#include "iomgr_config.hpp"
+
+extern "C" {
+#include <spdk/bdev_module.h>
+}
 
 using log_level = spdlog::level::level_enum;
 
@@ -42,7 +54,9 @@ SISL_OPTION_GROUP(test_drive_interface,
                    ::cxxopts::value< std::string >()->default_value("/tmp/iomgr_test_drive"), "path"),
                   (dev_size_mb, "", "dev_size_mb", "size of each device in MB",
                    ::cxxopts::value< uint64_t >()->default_value("100"), "number"),
-                  (spdk, "", "spdk", "spdk", ::cxxopts::value< bool >()->default_value("false"), "true or false"));
+                  (spdk, "", "spdk", "spdk", ::cxxopts::value< bool >()->default_value("false"), "true or false"),
+                  (aio, "", "aio", "use aio even if uring is supported",
+                   ::cxxopts::value< bool >()->default_value("false"), "true or false"));
 
 #define ENABLED_OPTIONS logging, iomgr, test_drive_interface, config
 SISL_OPTIONS_ENABLE(ENABLED_OPTIONS)
@@ -121,7 +135,14 @@ public:
 
         m_each_thread_size = (dev_size - 1) / m_nthreads + 1;
         LOGINFO("Starting iomgr with {} threads, spdk: {}", m_nthreads, is_spdk);
-        ioenvironment.with_iomgr(iomgr_params{.num_threads = m_nthreads, .is_spdk = is_spdk, .num_fibers = nfibers});
+        if (SISL_OPTIONS["aio"].as< bool >()) {
+            ioenvironment.with_iomgr(
+                iomgr_params{.num_threads = m_nthreads, .is_spdk = is_spdk, .num_fibers = nfibers}, nullptr,
+                []() { iomanager.add_drive_interface(std::make_shared< AioDriveInterface >()); });
+        } else {
+            ioenvironment.with_iomgr(
+                iomgr_params{.num_threads = m_nthreads, .is_spdk = is_spdk, .num_fibers = nfibers});
+        }
 
         std::stringstream iomgr_ver;
         iomgr_ver << iomgr::get_version();
@@ -454,6 +475,54 @@ public:
         }
     }
 
+    struct qos_writes {
+        explicit qos_writes(size_t n) : reqs(n) {}
+
+        std::vector< io_req > reqs;
+        std::vector< folly::Future< folly::Unit > > futs;
+        std::atomic< uint32_t > nerrors{0};
+        std::mutex mtx;
+        std::vector< io_class > completed; // Classes of the writes in the order they completed
+
+        void wait() {
+            for (auto& f : futs) {
+                std::move(f).wait();
+            }
+        }
+    };
+
+    // Issues writes of the given classes to consecutive blocks from offset, all from one worker reactor so that QoS
+    // of the device sees them together. None of them can complete until the reactor is back to its loop, so
+    // after_issue, which runs on the reactor right after, observes the admission alone.
+    void issue_qos_writes(qos_writes& w, const std::vector< io_class >& classes, uint64_t offset,
+                          const std::function< void() >& after_issue = nullptr) {
+        iomanager.run_on_wait(reactor_regex::random_worker, [&]() {
+            for (size_t i{0}; i < classes.size(); ++i) {
+                DriveInterface::set_thread_io_class(classes[i]);
+                w.futs.push_back(m_iodev->drive_interface()
+                                     ->async_write(m_iodev.get(), r_cast< const char* >(w.reqs[i].buf), s_io_size,
+                                                   offset + (i * s_io_size))
+                                     .thenValue([&w, cls = classes[i]](std::error_code err) {
+                                         if (err) { ++w.nerrors; }
+                                         std::unique_lock lg{w.mtx};
+                                         w.completed.push_back(cls);
+                                     }));
+            }
+            DriveInterface::set_thread_io_class(io_class::normal);
+            if (after_issue) { after_issue(); }
+        });
+    }
+
+    // Spdk merges the batch built outside its reactors, while kernel interfaces merge the batch submitted on a reactor
+    void submit_mergeable(std::span< const drive_io_request > reqs) {
+        auto iface = m_iodev->drive_interface();
+        if (iface->interface_type() == drive_interface_type::spdk) {
+            iface->async_submit(reqs);
+        } else {
+            iomanager.run_on_wait(reactor_regex::random_worker, [iface, reqs]() { iface->async_submit(reqs); });
+        }
+    }
+
 protected:
     io_device_ptr m_iodev{nullptr};
     std::atomic< size_t > m_next_available_range{0};
@@ -465,12 +534,433 @@ protected:
 
 iomgr::drive_attributes DriveTest::s_driveattr;
 
+static void on_io_completion(std::error_code err, void* cookie) {
+    r_cast< folly::Promise< std::error_code >* >(cookie)->setValue(err);
+}
+
+// Value of the counter of the drive interface metrics, looked up by its description
+static int64_t iface_counter(DriveInterface* iface, const std::string& desc) {
+    std::string group;
+    switch (iface->interface_type()) {
+    case drive_interface_type::aio:
+        group = "AioDriveInterface";
+        break;
+    case drive_interface_type::uring:
+        group = "UringDriveInterface";
+        break;
+    default:
+        group = "SpdkDriveInterface";
+        break;
+    }
+    const auto j = sisl::MetricsFarm::getInstance().get_result_in_json();
+    return j.at(group).at(group).at("Counters").at(desc).get< int64_t >();
+}
+
+static void set_aio_user_space_reap(bool enable) {
+    IM_SETTINGS_FACTORY().modifiable_settings([enable](auto& s) { s.aio.user_space_reap = enable; });
+    IM_SETTINGS_FACTORY().save();
+}
+
+// Enables user space reaping of aio for the scope, so that a failed test doesn't leave it on for the rest
+struct aio_user_space_reap_scope {
+    aio_user_space_reap_scope() { set_aio_user_space_reap(true); }
+    ~aio_user_space_reap_scope() { set_aio_user_space_reap(false); }
+};
+
+// Value of the counter of the QoS metrics of the io class of the device, looked up by its description
+static int64_t qos_counter(const IODevice* iodev, io_class cls, const std::string& desc) {
+    const auto j = sisl::MetricsFarm::getInstance().get_result_in_json();
+    return j.at("DriveQoS")
+        .at(fmt::format("{}_{}", iodev->devname, enum_name(cls)))
+        .at("Counters")
+        .at(desc)
+        .get< int64_t >();
+}
+
+static void set_merge_batch_ios(bool enable) {
+    IM_SETTINGS_FACTORY().modifiable_settings([enable](auto& s) { s.drive.merge_batch_ios = enable; });
+    IM_SETTINGS_FACTORY().save();
+}
+
+// Enables merging of the batched ios for the scope, so that a failed test doesn't leave it on for the rest
+struct merge_batch_ios_scope {
+    merge_batch_ios_scope() { set_merge_batch_ios(true); }
+    ~merge_batch_ios_scope() { set_merge_batch_ios(false); }
+};
+
+static const std::string s_merged_ios{"Number of ios issued for the contiguous batched ios merged together"};
+static const std::string s_merged_member_ios{"Number of batched ios which were merged into another io"};
+static const std::string s_qos_ios{"Number of ios admitted to the device by QoS"};
+static const std::string s_qos_queued_ios{"Number of ios which were held back by QoS before admission"};
+
 TEST_F(DriveTest, io_on_different_threads) {
     io_on_worker_threads();
     io_on_user_threads();
     io_on_regular_threads();
 }
 
+TEST_F(DriveTest, durable_write) {
+    static constexpr size_t offset{0};
+    io_req wreq;
+    wreq.buf_arr->fill(offset + 1);
+    auto err = m_iodev->drive_interface()
+                   ->async_write_durable(m_iodev.get(), r_cast< const char* >(wreq.buf), s_io_size, offset)
+                   .get();
+    ASSERT_FALSE(err) << "Durable write failed with error " << err.message();
+
+    io_req rreq;
+    err = m_iodev->drive_interface()->sync_read(m_iodev.get(), r_cast< char* >(rreq.buf), s_io_size, offset);
+    ASSERT_FALSE(err) << "Read after durable write failed with error " << err.message();
+    ASSERT_EQ(*wreq.buf_arr, *rreq.buf_arr) << "Data read back is not same as durable write";
+}
+
+TEST_F(DriveTest, fsync) {
+    auto iface = m_iodev->drive_interface();
+    if (iface->interface_type() == drive_interface_type::spdk) { GTEST_SKIP() << "fsync is not supported on spdk"; }
+
+    static constexpr size_t offset{0};
+    io_req wreq;
+    wreq.buf_arr->fill(offset + 2);
+    auto err = iface->async_write(m_iodev.get(), r_cast< const char* >(wreq.buf), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Write before fsync failed with error " << err.message();
+    err = iface->queue_fsync(m_iodev.get()).get();
+    ASSERT_FALSE(err) << "fsync failed with error " << err.message();
+}
+
+TEST_F(DriveTest, callback_io) {
+    static constexpr size_t offset{s_io_size};
+    io_req wreq;
+    wreq.buf_arr->fill(offset);
+    folly::Promise< std::error_code > write_done;
+    auto wf = write_done.getFuture();
+    m_iodev->drive_interface()->async_write_cb(m_iodev.get(), r_cast< const char* >(wreq.buf), s_io_size, offset,
+                                               drive_comp_cb{on_io_completion, &write_done});
+    auto err = std::move(wf).get();
+    ASSERT_FALSE(err) << "Write with callback failed with error " << err.message();
+
+    io_req rreq;
+    folly::Promise< std::error_code > read_done;
+    auto rf = read_done.getFuture();
+    m_iodev->drive_interface()->async_read_cb(m_iodev.get(), r_cast< char* >(rreq.buf), s_io_size, offset,
+                                              drive_comp_cb{on_io_completion, &read_done});
+    err = std::move(rf).get();
+    ASSERT_FALSE(err) << "Read with callback failed with error " << err.message();
+    ASSERT_EQ(*wreq.buf_arr, *rreq.buf_arr) << "Data read back is not same as written";
+}
+
+TEST_F(DriveTest, vectored_submit) {
+    static constexpr size_t nreqs{4};
+    static constexpr size_t base_offset{2 * s_io_size};
+    std::array< io_req, nreqs > wreqs;
+    std::array< io_req, nreqs > rreqs;
+    std::array< folly::Promise< std::error_code >, nreqs > done;
+    std::array< drive_io_request, nreqs > reqs;
+
+    const auto submit_and_wait = [&](DriveOpType op, std::array< io_req, nreqs >& ioreqs) {
+        std::vector< folly::Future< std::error_code > > futs;
+        for (size_t i{0}; i < nreqs; ++i) {
+            done[i] = folly::Promise< std::error_code >{};
+            futs.push_back(done[i].getFuture());
+            reqs[i] = drive_io_request{m_iodev.get(), op, r_cast< char* >(ioreqs[i].buf), nullptr, 0, s_io_size,
+                                       base_offset + (i * s_io_size), drive_comp_cb{on_io_completion, &done[i]}};
+        }
+        m_iodev->drive_interface()->async_submit(reqs);
+        for (auto& f : futs) {
+            auto err = std::move(f).get();
+            ASSERT_FALSE(err) << "Vectored " << enum_name(op) << " failed with error " << err.message();
+        }
+    };
+
+    for (size_t i{0}; i < nreqs; ++i) {
+        wreqs[i].buf_arr->fill(base_offset + i);
+    }
+    submit_and_wait(DriveOpType::WRITE, wreqs);
+    submit_and_wait(DriveOpType::READ, rreqs);
+    for (size_t i{0}; i < nreqs; ++i) {
+        ASSERT_EQ(*wreqs[i].buf_arr, *rreqs[i].buf_arr) << "Data read back is not same as written for request " << i;
+    }
+}
+
+TEST_F(DriveTest, block_cache) {
+    static constexpr size_t offset{8 * s_io_size};
+    block_cache_params params;
+    params.capacity = 16 * s_io_size;
+    params.block_size = s_io_size;
+    BlockCache cache{"test_drive_cache", params};
+
+    io_req wreq;
+    wreq.buf_arr->fill(offset + 3);
+    auto err = cache.async_write(m_iodev.get(), r_cast< const char* >(wreq.buf), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Write through cache failed with error " << err.message();
+
+    io_req rreq;
+    err = cache.async_read(m_iodev.get(), r_cast< char* >(rreq.buf), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Read through cache failed with error " << err.message();
+    ASSERT_EQ(*wreq.buf_arr, *rreq.buf_arr) << "Data read from cache is not same as written";
+    ASSERT_EQ(cache.hit_ratio(), 1.0) << "Read of the block just written through is expected to hit";
+
+    err = cache.async_write_zero(m_iodev.get(), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Write zero through cache failed with error " << err.message();
+    err = cache.async_read(m_iodev.get(), r_cast< char* >(rreq.buf), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Read after write zero failed with error " << err.message();
+    ASSERT_TRUE(std::all_of(rreq.buf_arr->begin(), rreq.buf_arr->end(), [](size_t v) { return v == 0; }))
+        << "Cached block is not invalidated by write zero";
+    ASSERT_LT(cache.hit_ratio(), 1.0) << "Read after write zero is expected to miss";
+}
+
+TEST_F(DriveTest, aio_user_space_reap) {
+    static constexpr size_t offset{12 * s_io_size};
+    static const std::string user_reaped{"Number of aio completions reaped from the ring mapped to user space"};
+    static const std::string syscall_reaped{"Number of aio completions reaped through io_getevents"};
+    auto iface = m_iodev->drive_interface();
+    if (iface->interface_type() != drive_interface_type::aio) { GTEST_SKIP() << "Test is only for aio"; }
+
+    // It is opt-in and decided as the aio context of a reactor is set up, so restart the IOManager with it on
+    aio_user_space_reap_scope reap_scope;
+    TearDown();
+    SetUp();
+    iface = m_iodev->drive_interface();
+
+    const auto user_reaped_before = iface_counter(iface, user_reaped);
+    const auto syscall_reaped_before = iface_counter(iface, syscall_reaped);
+    io_req wreq;
+    wreq.buf_arr->fill(offset);
+    auto err = iface->async_write(m_iodev.get(), r_cast< const char* >(wreq.buf), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Write failed with error " << err.message();
+    io_req rreq;
+    err = iface->async_read(m_iodev.get(), r_cast< char* >(rreq.buf), s_io_size, offset).get();
+    ASSERT_FALSE(err) << "Read failed with error " << err.message();
+    ASSERT_EQ(*wreq.buf_arr, *rreq.buf_arr) << "Data read back is not same as written";
+
+    // Every kernel since 3.10 maps the ring of the known layout, so all completions are reaped in user space
+    ASSERT_GE(iface_counter(iface, user_reaped), user_reaped_before + 2)
+        << "Aio completions are not reaped from the user space ring";
+    ASSERT_EQ(iface_counter(iface, syscall_reaped), syscall_reaped_before)
+        << "Aio completions are reaped through io_getevents";
+}
+
+TEST_F(DriveTest, spdk_split_io) {
+    static const std::string split_ios{"Count of ios split by iomgr as per the bdev io boundary and segment limits"};
+    static const std::string split_child_ios{"Count of child ios issued for the split ios"};
+    auto iface = m_iodev->drive_interface();
+    if (iface->interface_type() != drive_interface_type::spdk) { GTEST_SKIP() << "Test is only for spdk"; }
+
+    // Limit the bdev to 8 blocks per optimal io and 2 segments per io, so that a 4 block io starting at block 6
+    // crosses the boundary and its first 2 iovs, which are not block multiples, hit the segment limit short of it
+    auto* bdev = m_iodev->bdev();
+    const uint64_t blk = spdk_bdev_get_block_size(bdev);
+    const auto saved_boundary = bdev->optimal_io_boundary;
+    const auto saved_max_segs = bdev->max_num_segments;
+    bdev->optimal_io_boundary = 8;
+    bdev->max_num_segments = 2;
+
+    const uint64_t offset{16 * s_io_size + 6 * blk};
+    const uint32_t size = s_cast< uint32_t >(4 * blk);
+    uint8_t* wbuf = iomanager.iobuf_alloc(s_driveattr.align_size, size);
+    for (uint32_t i{0}; i < size; ++i) {
+        wbuf[i] = s_cast< uint8_t >(i % 251);
+    }
+    const std::array< iovec, 3 > iovs{iovec{wbuf, blk - 24}, iovec{wbuf + blk - 24, blk - 40},
+                                      iovec{wbuf + 2 * blk - 64, 2 * blk + 64}};
+
+    static std::atomic< uint32_t > s_ncompletions;
+    s_ncompletions = 0;
+    folly::Promise< std::error_code > write_done;
+    auto wf = write_done.getFuture();
+    const auto split_before = iface_counter(iface, split_ios);
+    const auto split_child_before = iface_counter(iface, split_child_ios);
+    iface->async_writev_cb(m_iodev.get(), iovs.data(), s_cast< int >(iovs.size()), size, offset,
+                           drive_comp_cb{[](std::error_code err, void* cookie) {
+                                             if (++s_ncompletions == 1) { on_io_completion(err, cookie); }
+                                         },
+                                         &write_done});
+    auto err = std::move(wf).get();
+    bdev->optimal_io_boundary = saved_boundary;
+    bdev->max_num_segments = saved_max_segs;
+    ASSERT_FALSE(err) << "Split write failed with error " << err.message();
+
+    uint8_t* rbuf = iomanager.iobuf_alloc(s_driveattr.align_size, size);
+    err = iface->async_read(m_iodev.get(), r_cast< char* >(rbuf), size, offset).get();
+    ASSERT_FALSE(err) << "Read of split write failed with error " << err.message();
+    ASSERT_EQ(std::memcmp(wbuf, rbuf, size), 0) << "Data read back is not same as written by split io";
+    ASSERT_EQ(iface_counter(iface, split_ios), split_before + 1) << "Write crossing the io boundary is not split";
+    // Segment limit cuts the first child back to 1 block, second one fills up to the boundary and the last is past it
+    ASSERT_EQ(iface_counter(iface, split_child_ios), split_child_before + 3) << "Split write has unexpected children";
+
+    // Any extra completion of the parent would have come by the time the read, issued after it, completed
+    ASSERT_EQ(s_ncompletions.load(), 1u) << "Parent of the split io is completed more than once";
+    iomanager.iobuf_free(wbuf);
+    iomanager.iobuf_free(rbuf);
+}
+
+TEST_F(DriveTest, qos_iops_limit) {
+    static constexpr uint64_t iops_limit{200};
+    static constexpr size_t nios{100};
+    drive_qos_params params;
+    params.iops_limit = iops_limit;
+    DriveInterface::set_qos(m_iodev.get(), params);
+    const auto queued_before = qos_counter(m_iodev.get(), io_class::normal, s_qos_queued_ios);
+    const auto admitted_before = qos_counter(m_iodev.get(), io_class::normal, s_qos_ios);
+
+    qos_writes w{nios};
+    const auto start = Clock::now();
+    issue_qos_writes(w, std::vector< io_class >(nios, io_class::normal), 32 * s_io_size);
+    w.wait();
+    const auto elapsed_ms = get_elapsed_time_ms(start);
+    ASSERT_EQ(w.nerrors.load(), 0u) << "Writes under iops limit failed";
+
+    // Only the burst worth of tokens goes through right away, the rest is paced at the limit. Bounds are kept at
+    // half of that, since the exact burst depends on the qos_burst_us config.
+    ASSERT_GE(qos_counter(m_iodev.get(), io_class::normal, s_qos_queued_ios), queued_before + (int64_t)nios / 2)
+        << "Writes beyond the iops limit are not held back";
+    ASSERT_EQ(qos_counter(m_iodev.get(), io_class::normal, s_qos_ios), admitted_before + (int64_t)nios)
+        << "Every write is expected to be admitted eventually";
+    ASSERT_GE(elapsed_ms, (nios / 2) * 1000 / iops_limit) << "Writes are not throttled to the iops limit";
+}
+
+TEST_F(DriveTest, qos_max_depth) {
+    static constexpr size_t nios{8};
+    drive_qos_params params;
+    params.max_depth[s_cast< uint32_t >(io_class::normal)] = 1;
+    DriveInterface::set_qos(m_iodev.get(), params);
+    const auto queued_before = qos_counter(m_iodev.get(), io_class::normal, s_qos_queued_ios);
+    const auto admitted_before = qos_counter(m_iodev.get(), io_class::normal, s_qos_ios);
+
+    int64_t queued_at_issue{0};
+    int64_t admitted_at_issue{0};
+    qos_writes w{nios};
+    issue_qos_writes(w, std::vector< io_class >(nios, io_class::normal), 48 * s_io_size, [&]() {
+        queued_at_issue = qos_counter(m_iodev.get(), io_class::normal, s_qos_queued_ios);
+        admitted_at_issue = qos_counter(m_iodev.get(), io_class::normal, s_qos_ios);
+    });
+    w.wait();
+    ASSERT_EQ(w.nerrors.load(), 0u) << "Writes under depth limit failed";
+
+    // Nothing completes while the writes are issued, so only the first one is on the device and the rest are held
+    ASSERT_EQ(admitted_at_issue, admitted_before + 1) << "Writes beyond max depth are admitted";
+    ASSERT_EQ(queued_at_issue, queued_before + (int64_t)nios - 1) << "Writes beyond max depth are not held back";
+    ASSERT_EQ(qos_counter(m_iodev.get(), io_class::normal, s_qos_ios), admitted_before + (int64_t)nios)
+        << "Held back writes are not released as the earlier ones complete";
+}
+
+TEST_F(DriveTest, qos_class_weights) {
+    static constexpr size_t nios_per_class{40};
+    drive_qos_params params;
+    params.iops_limit = 200;
+    params.weights[s_cast< uint32_t >(io_class::normal)] = 4;
+    params.weights[s_cast< uint32_t >(io_class::background)] = 1;
+    DriveInterface::set_qos(m_iodev.get(), params);
+
+    // Background writes are issued only after all the normal ones, so any share they get is from the weights
+    std::vector< io_class > classes(nios_per_class, io_class::normal);
+    classes.insert(classes.end(), nios_per_class, io_class::background);
+    qos_writes w{classes.size()};
+    issue_qos_writes(w, classes, 64 * s_io_size);
+    w.wait();
+    ASSERT_EQ(w.nerrors.load(), 0u) << "Writes of the weighted classes failed";
+
+    const auto last_normal = std::find(w.completed.rbegin(), w.completed.rend(), io_class::normal);
+    const auto background_before_normal_done =
+        std::count(last_normal, w.completed.rend(), io_class::background);
+    // Normal class with 4 times the weight gets about 4 admissions for each background one while both are held back
+    ASSERT_GE(background_before_normal_done, (int64_t)nios_per_class / 8)
+        << "Background class is starved while normal class is backlogged";
+    ASSERT_LE(background_before_normal_done, (int64_t)nios_per_class / 2)
+        << "Background class gets more than its weighted share";
+}
+
+TEST_F(DriveTest, qos_update_while_queued) {
+    static constexpr uint64_t iops_limit{10};
+    static constexpr size_t nios{20};
+    drive_qos_params params;
+    params.iops_limit = iops_limit;
+    DriveInterface::set_qos(m_iodev.get(), params);
+    const auto queued_before = qos_counter(m_iodev.get(), io_class::normal, s_qos_queued_ios);
+
+    qos_writes w{nios};
+    const auto start = Clock::now();
+    issue_qos_writes(w, std::vector< io_class >(nios, io_class::normal), 96 * s_io_size);
+    ASSERT_GE(qos_counter(m_iodev.get(), io_class::normal, s_qos_queued_ios), queued_before + (int64_t)nios / 2)
+        << "Writes beyond the iops limit are not held back";
+
+    // Lifting the limit has to admit the held back writes right away, rather than at the old rate
+    DriveInterface::set_qos(m_iodev.get(), drive_qos_params{});
+    w.wait();
+    ASSERT_EQ(w.nerrors.load(), 0u) << "Writes held back across QoS update failed";
+    ASSERT_LT(get_elapsed_time_ms(start), (nios / 2) * 1000 / iops_limit)
+        << "Held back writes are still paced at the old limit after it is lifted";
+}
+
+TEST_F(DriveTest, merge_batch_ios) {
+    static constexpr size_t nreqs{8};
+    static constexpr size_t base_offset{128 * s_io_size};
+    auto iface = m_iodev->drive_interface();
+    merge_batch_ios_scope merge_scope;
+
+    std::array< io_req, nreqs > wreqs;
+    std::array< folly::Promise< std::error_code >, nreqs > done;
+    std::array< drive_io_request, nreqs > reqs;
+    std::vector< folly::Future< std::error_code > > futs;
+    for (size_t i{0}; i < nreqs; ++i) {
+        wreqs[i].buf_arr->fill(base_offset + i);
+        futs.push_back(done[i].getFuture());
+        reqs[i] = drive_io_request{m_iodev.get(), DriveOpType::WRITE, r_cast< char* >(wreqs[i].buf), nullptr, 0,
+                                   s_io_size, base_offset + (i * s_io_size), drive_comp_cb{on_io_completion, &done[i]}};
+    }
+
+    const auto merged_before = iface_counter(iface, s_merged_ios);
+    const auto members_before = iface_counter(iface, s_merged_member_ios);
+    submit_mergeable(reqs);
+    for (size_t i{0}; i < nreqs; ++i) {
+        auto err = std::move(futs[i]).get();
+        ASSERT_FALSE(err) << "Merged write member " << i << " failed with error " << err.message();
+    }
+    ASSERT_EQ(iface_counter(iface, s_merged_ios), merged_before + 1) << "Contiguous batched writes are not merged";
+    ASSERT_EQ(iface_counter(iface, s_merged_member_ios), members_before + (int64_t)nreqs)
+        << "Not every batched write is merged";
+
+    io_req rreq;
+    for (size_t i{0}; i < nreqs; ++i) {
+        auto err = iface->sync_read(m_iodev.get(), r_cast< char* >(rreq.buf), s_io_size, base_offset + (i * s_io_size));
+        ASSERT_FALSE(err) << "Read after merged write failed with error " << err.message();
+        ASSERT_EQ(*wreqs[i].buf_arr, *rreq.buf_arr) << "Data read back is not same as written by member " << i;
+    }
+}
+
+TEST_F(DriveTest, merge_batch_ios_error) {
+    static constexpr size_t nreqs{4};
+    static constexpr size_t base_offset{144 * s_io_size};
+    auto iface = m_iodev->drive_interface();
+    if (iface->interface_type() == drive_interface_type::spdk) { GTEST_SKIP() << "Test needs a read only kernel fd"; }
+    merge_batch_ios_scope merge_scope;
+
+    // Writes to the device opened read only fail as a whole in the kernel
+    auto ro_dev = DriveInterface::open_dev(m_dev_path, O_RDONLY);
+    std::array< io_req, nreqs > wreqs;
+    std::array< folly::Promise< std::error_code >, nreqs > done;
+    std::array< drive_io_request, nreqs > reqs;
+    std::vector< folly::Future< std::error_code > > futs;
+    for (size_t i{0}; i < nreqs; ++i) {
+        futs.push_back(done[i].getFuture());
+        reqs[i] = drive_io_request{ro_dev.get(), DriveOpType::WRITE, r_cast< char* >(wreqs[i].buf), nullptr, 0,
+                                   s_io_size, base_offset + (i * s_io_size), drive_comp_cb{on_io_completion, &done[i]}};
+    }
+
+    const auto merged_before = iface_counter(iface, s_merged_ios);
+    submit_mergeable(reqs);
+    std::vector< std::error_code > errs;
+    for (auto& f : futs) {
+        errs.push_back(std::move(f).get());
+    }
+    ro_dev->drive_interface()->close_dev(ro_dev);
+
+    ASSERT_EQ(iface_counter(iface, s_merged_ios), merged_before + 1) << "Contiguous batched writes are not merged";
+    ASSERT_TRUE(errs[0]) << "Merged write to read only device succeeded";
+    for (size_t i{1}; i < nreqs; ++i) {
+        ASSERT_EQ(errs[i], errs[0]) << "Member " << i << " didn't get the error of the merged write";
+    }
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     SISL_OPTIONS_LOAD(argc, argv, ENABLED_OPTIONS);
@@ -18,6 +18,7 @@
 
 #include <iomgr/io_environment.hpp>
 #include <iomgr/iomgr.hpp>
+#include "interfaces/aio_drive_interface.hpp"
 
 using namespace iomgr;
 using namespace std::chrono_literals;
@@ -27,6 +28,8 @@ SISL_LOGGING_INIT(IOMGR_LOG_MODS, flip)
 SISL_OPTION_GROUP(test_write_zeros,
                   (dev, "", "dev", "dev", ::cxxopts::value< std::string >()->default_value("/tmp/test_wz"), "path"),
                   (spdk, "", "spdk", "spdk", ::cxxopts::value< bool >()->default_value("false"), "true or false"),
+                  (aio, "", "aio", "use aio even if uring is supported",
+                   ::cxxopts::value< bool >()->default_value("false"), "true or false"),
                   //(size, "", "size", "size", ::cxxopts::value< uint64_t >()->default_value("2147483648"), "number"),
                   (size, "", "size", "size", ::cxxopts::value< uint64_t >()->default_value("2097152"), "number"),
                   (offset, "", "offset", "offset", ::cxxopts::value< uint64_t >()->default_value("0"), "number"))
@@ -80,7 +83,13 @@ public:
         }
 
         const auto is_spdk = SISL_OPTIONS["spdk"].as< bool >();
-        ioenvironment.with_iomgr(iomgr_params{.num_threads = 1, .is_spdk = is_spdk});
+        if (SISL_OPTIONS["aio"].as< bool >()) {
+            ioenvironment.with_iomgr(iomgr_params{.num_threads = 1, .is_spdk = is_spdk}, nullptr, []() {
+                iomanager.add_drive_interface(std::make_shared< AioDriveInterface >());
+            });
+        } else {
+            ioenvironment.with_iomgr(iomgr_params{.num_threads = 1, .is_spdk = is_spdk});
+        }
 
         int oflags{O_CREAT | O_RDWR};
         if (is_spdk) { oflags |= O_DIRECT; }
@@ -138,7 +147,38 @@ public:
     void write_zero_and_read() {
         // Now issue write zeros
         m_start_time = Clock::now();
-        m_iodev->drive_interface()->sync_write_zero(m_iodev.get(), m_total_size, m_start_offset);
+        if (m_unmap) {
+            m_iodev->drive_interface()
+                ->async_unmap(m_iodev.get(), (uint32_t)m_total_size, m_start_offset)
+                .thenValue([this](std::error_code err) { on_async_zero_completion(err); });
+        } else if (m_async_zero) {
+            m_iodev->drive_interface()
+                ->async_write_zero(m_iodev.get(), m_total_size, m_start_offset)
+                .thenValue([this](std::error_code err) { on_async_zero_completion(err); });
+        } else {
+            m_iodev->drive_interface()->sync_write_zero(m_iodev.get(), m_total_size, m_start_offset);
+            read_and_validate();
+        }
+    }
+
+    void on_async_zero_completion(std::error_code err) {
+        // Asserts are left to the test thread, failing here would leave it waiting for the job forever
+        if (err) {
+            m_zero_err = err;
+            s_runner.job_done();
+            return;
+        }
+
+        // Discarded blocks of the block devices are not guaranteed to read back as zeros, files with holes punched
+        // always do
+        if (m_unmap && (m_iodev->dtype != drive_type::file_on_nvme) && (m_iodev->dtype != drive_type::file_on_hdd)) {
+            s_runner.job_done();
+            return;
+        }
+        read_and_validate();
+    }
+
+    void read_and_validate() {
         LOGINFO("Write zeros of size={} completed in {} microseconds, reading it back to validate 0s", m_total_size,
                 get_elapsed_time_us(m_start_time));
 
@@ -198,6 +238,9 @@ protected:
     io_device_ptr m_iodev;
     iomgr::drive_attributes m_driveattr;
     Clock::time_point m_start_time;
+    bool m_async_zero{false};
+    bool m_unmap{false};
+    std::error_code m_zero_err;
 };
 
 TEST_F(WriteZeroTest, fill_zero_validate) {
@@ -205,6 +248,23 @@ TEST_F(WriteZeroTest, fill_zero_validate) {
     s_runner.wait();
 }
 
+TEST_F(WriteZeroTest, async_fill_zero_validate) {
+    m_async_zero = true;
+    iomanager.run_on_forget(reactor_regex::least_busy_worker, [this]() { this->write_zero_test(); });
+    s_runner.wait();
+    ASSERT_FALSE(m_zero_err) << "Async write zero failed with error " << m_zero_err.message();
+}
+
+TEST_F(WriteZeroTest, async_unmap_validate) {
+    m_unmap = true;
+    iomanager.run_on_forget(reactor_regex::least_busy_worker, [this]() { this->write_zero_test(); });
+    s_runner.wait();
+    if (m_zero_err == std::errc::operation_not_supported) {
+        GTEST_SKIP() << "Unmap is not supported by the drive interface of this kernel";
+    }
+    ASSERT_FALSE(m_zero_err) << "Async unmap failed with error " << m_zero_err.message();
+}
+
 int main(int argc, char* argv[]) {
     ::testing::InitGoogleTest(&argc, argv);
     SISL_OPTIONS_LOAD(argc, argv, ENABLED_OPTIONS);